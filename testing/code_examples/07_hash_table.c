@@ -1,57 +1,481 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define INITIAL_SIZE 16
 #define LOAD_FACTOR 0.75
 #define GROWTH_FACTOR 2
+// Old buckets moved to the new table by each operation during an
+// incremental resize. Must exceed 1 / LOAD_FACTOR so a migration always
+// completes before the next resize is due.
+#define MIGRATE_BUCKETS_PER_OP 4
+// Migrated old buckets are handed back to the kernel in runs of this many
+// bytes, so freeing the old array at the end unmaps almost nothing
+#define MIGRATE_RELEASE_BYTES (256 * 1024)
+
+// Key arena: chunk sizes double from the first to the last size
+#define ARENA_FIRST_CHUNK 4096
+#define ARENA_MAX_CHUNK (1024 * 1024)
+// Key slots are rounded up to ARENA_MIN_STRING << class bytes so removed
+// keys can be reused by later keys of the same class
+#define ARENA_MIN_STRING 8
+#define ARENA_STRING_CLASSES 48
+
+// Open-addressing (Swiss table) backend parameters
+#define GROUP_WIDTH 16
+#define CTRL_EMPTY ((int8_t)0x80)
+#define SWISS_MAX_LOAD_NUM 7
+#define SWISS_MAX_LOAD_DEN 8
+
+// Keys in flight per group of insert_batch/get_batch
+#define BATCH_GROUP 16
+
+// Snapshot file format
+#define SNAPSHOT_MAGIC "HTSNAP\0\0"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HASH_WYHASH 1
+
+// Concurrent variant parameters
+#define CONCURRENT_STRIPES 64
+#define CONCURRENT_MAX_THREADS 128
+#define CONCURRENT_HELP_STRIPES 2
+#define EPOCH_RETIRE_THRESHOLD 64
+#define CACHE_LINE 64
+
+// Benchmark parameters
+#define BENCH_KEY_STRIDE 16
+#define BENCH_MISS_KEYS (1 << 20)
+#define LATENCY_DEFAULT_KEYS 10000000
+#define LATENCY_MAX_RESIZES 64
+#define CONCURRENT_BENCH_KEYS 2000000
+#define CONCURRENT_BENCH_THREADS 64
+#define CONCURRENT_BENCH_OPS 8000000
+#define HASH_BENCH_KEYS 1000000
+#define HASH_BENCH_MAX_LENGTH 256
+#define BATCH_BENCH_KEYS 10000000
+#define SNAPSHOT_BENCH_KEYS 10000000
+#define SNAPSHOT_BENCH_PATH "/tmp/07_hash_table.snap"
 
 // Node structure for chaining
 typedef struct HashNode {
     char* key;
+    uint64_t hash;
     int value;
     struct HashNode* next;
 } HashNode;
 
+// Chunk of the bump allocator holding keys and nodes
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} ArenaChunk;
+
+// Bump allocator owned by a table, released all at once by free_table.
+// Released strings are kept per size class, linked through their first
+// bytes.
+typedef struct {
+    ArenaChunk* head;
+    size_t next_chunk_size;
+    char* free_strings[ARENA_STRING_CLASSES];
+} Arena;
+
+// Hash function over the first length bytes of key; see hash_djb2,
+// hash_djb2_mixed and hash_wyhash
+typedef uint64_t (*HashFunc)(const char* key, size_t length);
+
+// Storage engine behind the insert/get/remove_key API
+typedef enum {
+    BACKEND_CHAINED,
+    BACKEND_SWISS
+} HashBackend;
+
+// Slot of the open-addressing backend
+typedef struct {
+    char* key;
+    uint64_t hash;
+    int value;
+} SwissSlot;
+
 // Hash table structure
 typedef struct {
+    HashBackend backend;
+    HashFunc hash;
     HashNode** table;
+    // Chained backend, incremental resize: buckets of old_table below
+    // migrate_index have already been moved into table, and the whole
+    // pages below release_index have been returned to the kernel
+    bool incremental;
+    HashNode** old_table;
+    size_t old_capacity;
+    size_t migrate_index;
+    size_t release_index;
+    // Swiss backend: one control byte per slot (CTRL_EMPTY or the 7-bit H2
+    // of the resident key), followed by GROUP_WIDTH bytes mirroring the
+    // first group so unaligned group loads never need to wrap
+    int8_t* ctrl;
+    SwissSlot* slots;
+    // Interned keys and chained nodes; removed nodes are recycled through
+    // free_nodes, removed keys through the arena's string classes
+    Arena arena;
+    HashNode* free_nodes;
     size_t size;
     size_t capacity;
     size_t collisions;
 } HashTable;
 
-// Function to create a new hash node
-HashNode* create_node(const char* key, int value) {
-    HashNode* node = (HashNode*)malloc(sizeof(HashNode));
-    if (!node) {
-        printf("Memory allocation failed\n");
-        exit(1);
+// Node of the concurrent table; key and hash never change once published
+typedef struct CNode {
+    _Atomic(struct CNode*) next;
+    _Atomic int value;
+    uint64_t hash;
+    char key[];
+} CNode;
+
+// Bucket array of the concurrent table. While a resize is in progress next
+// points at the larger array and migrated[s] tells whether stripe s has
+// already been copied there.
+typedef struct CBucketArray {
+    size_t capacity;
+    _Atomic(struct CBucketArray*) next;
+    atomic_bool migrated[CONCURRENT_STRIPES];
+    atomic_size_t migrate_cursor;
+    atomic_size_t migrated_count;
+    _Atomic(CNode*) buckets[];
+} CBucketArray;
+
+// Writer lock and entry count of one stripe. Stripe s owns every bucket
+// whose index is congruent to s modulo CONCURRENT_STRIPES, in all bucket
+// arrays, because capacities are powers of two of at least that many.
+typedef struct {
+    pthread_mutex_t lock;
+    size_t count;
+} __attribute__((aligned(CACHE_LINE))) Stripe;
+
+// Node or bucket array waiting for readers to move past it
+typedef struct {
+    void* ptr;
+    uint64_t epoch;
+    bool is_array;
+} RetiredItem;
+
+// Per-thread epoch state; the retired list is only touched by its owner
+typedef struct {
+    _Atomic uint64_t epoch;
+    atomic_bool active;
+    RetiredItem* retired;
+    size_t retired_count;
+    size_t retired_capacity;
+    size_t collect_at;
+} __attribute__((aligned(CACHE_LINE))) EpochRecord;
+
+// Concurrent hash table: writers lock one stripe, readers take no lock and
+// are protected from reclamation by epochs
+typedef struct {
+    HashFunc hash;
+    _Atomic(CBucketArray*) current;
+    Stripe stripes[CONCURRENT_STRIPES];
+    _Atomic uint64_t global_epoch;
+    atomic_size_t thread_count;
+    EpochRecord records[CONCURRENT_MAX_THREADS];
+} ConcurrentHashTable;
+
+// On-disk snapshot header. All offsets are relative to the start of the
+// file, so the image can be mapped at any address. Integers are stored in
+// native byte order.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t hash_id;
+    uint64_t capacity;
+    uint64_t size;
+    uint64_t ctrl_offset;
+    uint64_t slots_offset;
+    uint64_t keys_offset;
+    uint64_t keys_size;
+    uint64_t file_size;
+    uint64_t body_checksum;
+    uint64_t header_checksum;
+} SnapshotHeader;
+
+// Slot of a snapshot; the key lives at keys_offset + key_offset
+typedef struct {
+    uint64_t key_offset;
+    uint64_t hash;
+    int32_t value;
+    uint32_t key_length;
+} SnapshotSlot;
+
+// Read-only table served straight from a mapped snapshot file
+typedef struct {
+    void* map;
+    size_t map_size;
+    const SnapshotHeader* header;
+    const int8_t* ctrl;
+    const SnapshotSlot* slots;
+    const char* keys;
+} MappedHashTable;
+
+// Function to allocate size bytes aligned to align from the arena
+void* arena_alloc(Arena* arena, size_t size, size_t align) {
+    ArenaChunk* chunk = arena->head;
+    size_t offset = chunk ? (chunk->used + align - 1) & ~(align - 1) : 0;
+    
+    if (!chunk || offset + size > chunk->capacity) {
+        size_t capacity = arena->next_chunk_size;
+        if (capacity < size) {
+            capacity = size;
+        }
+        chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + capacity);
+        if (!chunk) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        chunk->next = arena->head;
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        arena->head = chunk;
+        if (arena->next_chunk_size < ARENA_MAX_CHUNK) {
+            arena->next_chunk_size *= 2;
+        }
+        offset = 0;
     }
     
-    node->key = strdup(key);
-    if (!node->key) {
-        printf("Memory allocation failed\n");
-        free(node);
-        exit(1);
+    chunk->used = offset + size;
+    return chunk->data + offset;
+}
+
+// Function to get the size class of a string of length bytes
+size_t arena_string_class(size_t length) {
+    size_t class = 0;
+    while (((size_t)ARENA_MIN_STRING << class) < length) {
+        class++;
+    }
+    return class;
+}
+
+// Function to copy a string into the arena, reusing a released string of
+// the same size class if possible
+char* arena_strdup(Arena* arena, const char* str) {
+    size_t length = strlen(str) + 1;
+    size_t class = arena_string_class(length);
+    char* copy = arena->free_strings[class];
+    
+    if (copy) {
+        memcpy(&arena->free_strings[class], copy, sizeof(char*));
+    } else {
+        copy = (char*)arena_alloc(arena, (size_t)ARENA_MIN_STRING << class, 1);
     }
     
+    memcpy(copy, str, length);
+    return copy;
+}
+
+// Function to hand a string from arena_strdup back for reuse
+void arena_release_string(Arena* arena, char* str) {
+    size_t class = arena_string_class(strlen(str) + 1);
+    memcpy(str, &arena->free_strings[class], sizeof(char*));
+    arena->free_strings[class] = str;
+}
+
+// Function to release every chunk of the arena
+void arena_free(Arena* arena) {
+    ArenaChunk* chunk = arena->head;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+}
+
+// Function to create a new hash node, reusing a removed node if possible
+HashNode* create_node(HashTable* table, const char* key, uint64_t hash, int value) {
+    HashNode* node = table->free_nodes;
+    if (node) {
+        table->free_nodes = node->next;
+    } else {
+        node = (HashNode*)arena_alloc(&table->arena, sizeof(HashNode), _Alignof(HashNode));
+    }
+    
+    node->key = arena_strdup(&table->arena, key);
+    node->hash = hash;
     node->value = value;
     node->next = NULL;
     return node;
 }
 
-// Function to create a new hash table
-HashTable* create_hash_table() {
+// DJB2, one byte per step; the table default for the chained backend
+uint64_t hash_djb2(const char* key, size_t length) {
+    uint64_t hash = 5381;
+    
+    for (size_t i = 0; i < length; i++) {
+        hash = ((hash << 5) + hash) + (unsigned char)key[i]; // hash * 33 + c
+    }
+    
+    return hash;
+}
+
+// Function to scramble a hash with the MurmurHash3 finalizer
+uint64_t mix_hash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// DJB2 with its bits mixed afterwards. Raw DJB2 leaves similar keys in
+// neighboring slots, which linear probing turns into long clusters.
+uint64_t hash_djb2_mixed(const char* key, size_t length) {
+    return mix_hash(hash_djb2(key, length));
+}
+
+// wyhash helpers: 64x64->128 bit multiply folded back to 64 bits, and
+// unaligned little-endian loads
+void wy_mum(uint64_t* a, uint64_t* b) {
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+}
+
+uint64_t wy_mix(uint64_t a, uint64_t b) {
+    wy_mum(&a, &b);
+    return a ^ b;
+}
+
+uint64_t wy_read8(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint64_t wy_read4(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// wyhash (final version 4, seed 0): consumes 8 bytes per load and up to
+// three independent 48-byte lanes, so long keys are not one serial chain
+uint64_t hash_wyhash(const char* key, size_t length) {
+    static const uint64_t secret[4] = {
+        0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+        0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+    };
+    const uint8_t* p = (const uint8_t*)key;
+    uint64_t seed = wy_mix(secret[0], secret[1]);
+    uint64_t a, b;
+    
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t shift = (length >> 3) << 2;
+            a = (wy_read4(p) << 32) | wy_read4(p + shift);
+            b = (wy_read4(p + length - 4) << 32) | wy_read4(p + length - 4 - shift);
+        } else if (length > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = length;
+        if (i > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = wy_mix(wy_read8(p) ^ secret[1], wy_read8(p + 8) ^ seed);
+                seed1 = wy_mix(wy_read8(p + 16) ^ secret[2], wy_read8(p + 24) ^ seed1);
+                seed2 = wy_mix(wy_read8(p + 32) ^ secret[3], wy_read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = wy_mix(wy_read8(p) ^ secret[1], wy_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = wy_read8(p + i - 16);
+        b = wy_read8(p + i - 8);
+    }
+    
+    a ^= secret[1];
+    b ^= seed;
+    wy_mum(&a, &b);
+    return wy_mix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+// Function to map a hash to one of capacity buckets. Capacities are
+// powers of two, so this is a mask rather than a hardware divide.
+size_t bucket_index(uint64_t hash, size_t capacity) {
+    return hash & (capacity - 1);
+}
+
+// Function to map a hash to [0, range) for any range with a multiply and
+// shift (Lemire's fastrange), using the high bits of the hash
+size_t fastrange(uint64_t hash, size_t range) {
+    return (size_t)(((__uint128_t)hash * range) >> 64);
+}
+
+// Function to allocate the control bytes and slots of the Swiss backend
+void swiss_alloc(HashTable* table, size_t capacity) {
+    table->ctrl = (int8_t*)malloc(capacity + GROUP_WIDTH);
+    table->slots = (SwissSlot*)malloc(capacity * sizeof(SwissSlot));
+    if (!table->ctrl || !table->slots) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    
+    memset(table->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+    table->capacity = capacity;
+}
+
+// Function to create a new hash table with the given backend
+HashTable* create_hash_table_with_backend(HashBackend backend) {
     HashTable* table = (HashTable*)malloc(sizeof(HashTable));
     if (!table) {
         printf("Memory allocation failed\n");
         exit(1);
     }
     
+    table->backend = backend;
+    // The Swiss backend needs well-mixed low bits for H2 and H1
+    table->hash = backend == BACKEND_SWISS ? hash_wyhash : hash_djb2;
     table->capacity = INITIAL_SIZE;
     table->size = 0;
     table->collisions = 0;
+    table->table = NULL;
+    table->incremental = false;
+    table->old_table = NULL;
+    table->old_capacity = 0;
+    table->migrate_index = 0;
+    table->release_index = 0;
+    table->ctrl = NULL;
+    table->slots = NULL;
+    table->arena.head = NULL;
+    table->arena.next_chunk_size = ARENA_FIRST_CHUNK;
+    memset(table->arena.free_strings, 0, sizeof(table->arena.free_strings));
+    table->free_nodes = NULL;
+    
+    if (backend == BACKEND_SWISS) {
+        swiss_alloc(table, INITIAL_SIZE);
+        return table;
+    }
     
     table->table = (HashNode**)calloc(table->capacity, sizeof(HashNode*));
     if (!table->table) {
@@ -63,16 +487,270 @@ HashTable* create_hash_table() {
     return table;
 }
 
-// Hash function
-size_t hash_function(const char* key, size_t capacity) {
-    size_t hash = 5381;
-    int c;
+// Function to create a new hash table
+HashTable* create_hash_table() {
+    return create_hash_table_with_backend(BACKEND_CHAINED);
+}
+
+// Function to replace the hash function of an empty table
+void set_hash_function(HashTable* table, HashFunc hash) {
+    if (table->size > 0) {
+        printf("Hash function can only be changed on an empty table\n");
+        return;
+    }
+    table->hash = hash;
+}
+
+// Function to hash a key with the table's hash function
+uint64_t table_hash(HashTable* table, const char* key) {
+    return table->hash(key, strlen(key));
+}
+
+// Swiss backend: the low 7 bits of the hash are stored in the control byte
+// (H2), the remaining bits pick the home slot (H1)
+size_t swiss_h1(uint64_t hash, size_t capacity) {
+    return (hash >> 7) & (capacity - 1);
+}
+
+int8_t swiss_h2(uint64_t hash) {
+    return (int8_t)(hash & 0x7F);
+}
+
+// Function to set a control byte, keeping the mirrored tail in sync
+void swiss_set_ctrl(HashTable* table, size_t index, int8_t ctrl) {
+    table->ctrl[index] = ctrl;
+    if (index < GROUP_WIDTH) {
+        table->ctrl[table->capacity + index] = ctrl;
+    }
+}
+
+#ifdef __SSE2__
+// Bitmask of the slots in the group starting at ctrl whose H2 matches
+uint32_t group_match(const int8_t* ctrl, int8_t h2) {
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+}
+
+// Bitmask of the empty slots in the group starting at ctrl
+uint32_t group_match_empty(const int8_t* ctrl) {
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+}
+#else
+// Bitmask of the slots in the group starting at ctrl whose H2 matches
+uint32_t group_match(const int8_t* ctrl, int8_t h2) {
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(ctrl[i] == h2) << i;
+    }
+    return mask;
+}
+
+// Bitmask of the empty slots in the group starting at ctrl
+uint32_t group_match_empty(const int8_t* ctrl) {
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(ctrl[i] == CTRL_EMPTY) << i;
+    }
+    return mask;
+}
+#endif
+
+// Function to find the slot holding key, or return capacity if absent.
+// Probing is linear, one group of GROUP_WIDTH slots at a time. Since
+// deletion backward-shifts instead of leaving tombstones, a key is never
+// stored past an empty slot of its probe sequence, so the first group
+// containing an empty slot ends the search.
+size_t swiss_find(HashTable* table, const char* key, uint64_t hash) {
+    size_t mask = table->capacity - 1;
+    size_t pos = swiss_h1(hash, table->capacity);
+    int8_t h2 = swiss_h2(hash);
+    
+    while (1) {
+        const int8_t* group = table->ctrl + pos;
+        uint32_t match = group_match(group, h2);
+        while (match) {
+            size_t index = (pos + __builtin_ctz(match)) & mask;
+            if (table->slots[index].hash == hash && strcmp(table->slots[index].key, key) == 0) {
+                return index;
+            }
+            match &= match - 1;
+        }
+        if (group_match_empty(group)) {
+            return table->capacity;
+        }
+        pos = (pos + GROUP_WIDTH) & mask;
+    }
+}
+
+// Function to find the first empty slot on the probe sequence of hash
+size_t swiss_find_empty(HashTable* table, uint64_t hash) {
+    size_t mask = table->capacity - 1;
+    size_t pos = swiss_h1(hash, table->capacity);
     
-    while ((c = *key++)) {
-        hash = ((hash << 5) + hash) + c; // hash * 33 + c
+    while (1) {
+        uint32_t empty = group_match_empty(table->ctrl + pos);
+        if (empty) {
+            return (pos + __builtin_ctz(empty)) & mask;
+        }
+        pos = (pos + GROUP_WIDTH) & mask;
+    }
+}
+
+// Function to grow the Swiss backend, moving slots without key compares
+// or rehashing
+void swiss_resize(HashTable* table) {
+    size_t old_capacity = table->capacity;
+    int8_t* old_ctrl = table->ctrl;
+    SwissSlot* old_slots = table->slots;
+    
+    swiss_alloc(table, old_capacity * GROWTH_FACTOR);
+    
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_ctrl[i] == CTRL_EMPTY) {
+            continue;
+        }
+        size_t index = swiss_find_empty(table, old_slots[i].hash);
+        swiss_set_ctrl(table, index, old_ctrl[i]);
+        table->slots[index] = old_slots[i];
+    }
+    
+    free(old_ctrl);
+    free(old_slots);
+}
+
+// Function to grow the Swiss backend until extra more keys fit
+void swiss_reserve(HashTable* table, size_t extra) {
+    while ((table->size + extra) * SWISS_MAX_LOAD_DEN > table->capacity * SWISS_MAX_LOAD_NUM) {
+        swiss_resize(table);
+    }
+}
+
+// Function to insert a key with a precomputed hash into the Swiss backend;
+// the caller has made room for it
+void swiss_insert_hashed(HashTable* table, const char* key, uint64_t hash, int value) {
+    size_t index = swiss_find(table, key, hash);
+    if (index != table->capacity) {
+        table->slots[index].value = value;
+        return;
+    }
+    
+    index = swiss_find_empty(table, hash);
+    if (index != swiss_h1(hash, table->capacity)) {
+        table->collisions++;
+    }
+    
+    table->slots[index].key = arena_strdup(&table->arena, key);
+    table->slots[index].hash = hash;
+    table->slots[index].value = value;
+    swiss_set_ctrl(table, index, swiss_h2(hash));
+    table->size++;
+}
+
+// Function to insert a key-value pair into the Swiss backend
+void swiss_insert(HashTable* table, const char* key, int value) {
+    swiss_reserve(table, 1);
+    swiss_insert_hashed(table, key, table_hash(table, key), value);
+}
+
+// Function to remove a key from the Swiss backend. Instead of leaving a
+// tombstone, later slots of the same probe run are shifted back into the
+// hole, which keeps every key reachable without an empty slot in between.
+void swiss_remove(HashTable* table, const char* key) {
+    size_t mask = table->capacity - 1;
+    size_t hole = swiss_find(table, key, table_hash(table, key));
+    if (hole == table->capacity) {
+        return;
+    }
+    
+    arena_release_string(&table->arena, table->slots[hole].key);
+    table->size--;
+    
+    size_t next = (hole + 1) & mask;
+    while (table->ctrl[next] != CTRL_EMPTY) {
+        size_t home = swiss_h1(table->slots[next].hash, table->capacity);
+        // Move the entry if its home does not lie in the range (hole, next]
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            table->slots[hole] = table->slots[next];
+            swiss_set_ctrl(table, hole, table->ctrl[next]);
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    swiss_set_ctrl(table, hole, CTRL_EMPTY);
+}
+
+// Function to switch the chained backend to incremental resizing, where
+// old and new bucket arrays coexist and every operation migrates a few
+// buckets instead of rehashing the whole table at once
+void enable_incremental_resize(HashTable* table) {
+    table->incremental = true;
+}
+
+// Function to move up to max_buckets buckets of an in-progress
+// incremental resize into the new table
+void migrate_buckets(HashTable* table, size_t max_buckets) {
+    if (!table->old_table) {
+        return;
+    }
+    
+    size_t remaining = table->old_capacity - table->migrate_index;
+    if (max_buckets > remaining) {
+        max_buckets = remaining;
+    }
+    
+    for (size_t n = 0; n < max_buckets; n++) {
+        HashNode* current = table->old_table[table->migrate_index];
+        while (current) {
+            HashNode* next = current->next;
+            size_t new_index = bucket_index(current->hash, table->capacity);
+            
+            current->next = table->table[new_index];
+            table->table[new_index] = current;
+            
+            current = next;
+        }
+        table->old_table[table->migrate_index++] = NULL;
+    }
+    
+    // Give back the pages of old buckets that are now all NULL. Unmapping
+    // a large array in one go costs milliseconds, which would land on the
+    // operation that finishes the migration.
+    if ((table->migrate_index - table->release_index) * sizeof(HashNode*) >= MIGRATE_RELEASE_BYTES) {
+        uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t start = ((uintptr_t)(table->old_table + table->release_index) + page - 1) & ~(page - 1);
+        uintptr_t end = (uintptr_t)(table->old_table + table->migrate_index) & ~(page - 1);
+        if (end > start) {
+            madvise((void*)start, end - start, MADV_DONTNEED);
+            table->release_index = (end - (uintptr_t)table->old_table) / sizeof(HashNode*);
+        }
+    }
+    
+    if (table->migrate_index == table->old_capacity) {
+        free(table->old_table);
+        table->old_table = NULL;
+        table->old_capacity = 0;
+        table->migrate_index = 0;
+        table->release_index = 0;
+    }
+}
+
+// Function to finish an in-progress incremental resize
+void finish_migration(HashTable* table) {
+    migrate_buckets(table, table->old_capacity);
+}
+
+// Function to get the not yet migrated old bucket a key with the given
+// hash would live in, or NULL if there is none
+HashNode** old_bucket(HashTable* table, uint64_t hash) {
+    if (!table->old_table) {
+        return NULL;
     }
     
-    return hash % capacity;
+    size_t index = bucket_index(hash, table->old_capacity);
+    if (index < table->migrate_index) {
+        return NULL;
+    }
+    return &table->old_table[index];
 }
 
 // Function to resize the hash table
@@ -80,6 +758,11 @@ void resize_table(HashTable* table) {
     size_t old_capacity = table->capacity;
     HashNode** old_table = table->table;
     
+    if (table->incremental) {
+        finish_migration(table);
+        old_table = table->table;
+    }
+    
     // Create new table with increased capacity
     table->capacity *= GROWTH_FACTOR;
     table->table = (HashNode**)calloc(table->capacity, sizeof(HashNode*));
@@ -88,12 +771,21 @@ void resize_table(HashTable* table) {
         exit(1);
     }
     
+    // Leave the rehash to subsequent operations
+    if (table->incremental) {
+        table->old_table = old_table;
+        table->old_capacity = old_capacity;
+        table->migrate_index = 0;
+        table->release_index = 0;
+        return;
+    }
+    
     // Rehash all elements
     for (size_t i = 0; i < old_capacity; i++) {
         HashNode* current = old_table[i];
         while (current) {
             HashNode* next = current->next;
-            size_t new_index = hash_function(current->key, table->capacity);
+            size_t new_index = bucket_index(current->hash, table->capacity);
             
             current->next = table->table[new_index];
             table->table[new_index] = current;
@@ -105,19 +797,24 @@ void resize_table(HashTable* table) {
     free(old_table);
 }
 
-// Function to insert a key-value pair
-void insert(HashTable* table, const char* key, int value) {
-    // Check if resize is needed
-    if ((double)table->size / table->capacity >= LOAD_FACTOR) {
-        resize_table(table);
+// Function to insert a key with a precomputed hash into the chained
+// backend, without the migration step or resize check
+void insert_hashed(HashTable* table, const char* key, uint64_t hash, int value) {
+    // Check the old bucket array while a resize is in progress
+    HashNode** old = old_bucket(table, hash);
+    for (HashNode* node = old ? *old : NULL; node; node = node->next) {
+        if (node->hash == hash && strcmp(node->key, key) == 0) {
+            node->value = value;
+            return;
+        }
     }
     
-    size_t index = hash_function(key, table->capacity);
+    size_t index = bucket_index(hash, table->capacity);
     HashNode* current = table->table[index];
     
     // Check if key already exists
     while (current) {
-        if (strcmp(current->key, key) == 0) {
+        if (current->hash == hash && strcmp(current->key, key) == 0) {
             current->value = value;
             return;
         }
@@ -125,7 +822,7 @@ void insert(HashTable* table, const char* key, int value) {
     }
     
     // Create new node
-    HashNode* new_node = create_node(key, value);
+    HashNode* new_node = create_node(table, key, hash, value);
     
     // Check for collision
     if (table->table[index]) {
@@ -138,13 +835,37 @@ void insert(HashTable* table, const char* key, int value) {
     table->size++;
 }
 
-// Function to get a value by key
-int get(HashTable* table, const char* key) {
-    size_t index = hash_function(key, table->capacity);
+// Function to insert a key-value pair
+void insert(HashTable* table, const char* key, int value) {
+    if (table->backend == BACKEND_SWISS) {
+        swiss_insert(table, key, value);
+        return;
+    }
+    
+    migrate_buckets(table, MIGRATE_BUCKETS_PER_OP);
+    
+    // Check if resize is needed
+    if ((double)table->size / table->capacity >= LOAD_FACTOR) {
+        resize_table(table);
+    }
+    
+    insert_hashed(table, key, table_hash(table, key), value);
+}
+
+// Function to look up a key with a precomputed hash in the chained backend
+int get_hashed(HashTable* table, const char* key, uint64_t hash) {
+    HashNode** old = old_bucket(table, hash);
+    for (HashNode* node = old ? *old : NULL; node; node = node->next) {
+        if (node->hash == hash && strcmp(node->key, key) == 0) {
+            return node->value;
+        }
+    }
+    
+    size_t index = bucket_index(hash, table->capacity);
     HashNode* current = table->table[index];
     
     while (current) {
-        if (strcmp(current->key, key) == 0) {
+        if (current->hash == hash && strcmp(current->key, key) == 0) {
             return current->value;
         }
         current = current->next;
@@ -153,61 +874,1432 @@ int get(HashTable* table, const char* key) {
     return -1; // Key not found
 }
 
-// Function to remove a key-value pair
-void remove_key(HashTable* table, const char* key) {
-    size_t index = hash_function(key, table->capacity);
-    HashNode* current = table->table[index];
+// Function to get a value by key
+int get(HashTable* table, const char* key) {
+    if (table->backend == BACKEND_SWISS) {
+        size_t index = swiss_find(table, key, table_hash(table, key));
+        return index == table->capacity ? -1 : table->slots[index].value;
+    }
+    
+    migrate_buckets(table, MIGRATE_BUCKETS_PER_OP);
+    return get_hashed(table, key, table_hash(table, key));
+}
+
+// Function to unlink key from the chain starting at *bucket and recycle
+// its node
+bool remove_from_bucket(HashTable* table, HashNode** bucket, const char* key, uint64_t hash) {
+    HashNode* current = *bucket;
     HashNode* prev = NULL;
     
     while (current) {
-        if (strcmp(current->key, key) == 0) {
+        if (current->hash == hash && strcmp(current->key, key) == 0) {
             if (prev) {
                 prev->next = current->next;
             } else {
-                table->table[index] = current->next;
+                *bucket = current->next;
             }
             
-            free(current->key);
-            free(current);
+            arena_release_string(&table->arena, current->key);
+            current->next = table->free_nodes;
+            table->free_nodes = current;
             table->size--;
-            return;
+            return true;
         }
         prev = current;
         current = current->next;
     }
+    return false;
 }
 
-// Function to print the hash table
-void print_table(HashTable* table) {
-    printf("\nHash Table Contents:\n");
-    for (size_t i = 0; i < table->capacity; i++) {
-        printf("Bucket %zu: ", i);
-        HashNode* current = table->table[i];
-        while (current) {
-            printf("[%s: %d] -> ", current->key, current->value);
-            current = current->next;
-        }
-        printf("NULL\n");
+// Function to remove a key-value pair
+void remove_key(HashTable* table, const char* key) {
+    if (table->backend == BACKEND_SWISS) {
+        swiss_remove(table, key);
+        return;
     }
-    printf("\nTotal collisions: %zu\n", table->collisions);
+    
+    migrate_buckets(table, MIGRATE_BUCKETS_PER_OP);
+    
+    uint64_t hash = table_hash(table, key);
+    HashNode** old = old_bucket(table, hash);
+    if (old && remove_from_bucket(table, old, key, hash)) {
+        return;
+    }
+    
+    size_t index = bucket_index(hash, table->capacity);
+    remove_from_bucket(table, &table->table[index], key, hash);
 }
 
-// Function to free the hash table
-void free_table(HashTable* table) {
-    for (size_t i = 0; i < table->capacity; i++) {
-        HashNode* current = table->table[i];
-        while (current) {
-            HashNode* next = current->next;
-            free(current->key);
-            free(current);
-            current = next;
+// Function to hash a group of keys and prefetch the cache lines their
+// lookups will touch first: the bucket heads of the chained backend, or
+// the control group and first slot of the Swiss backend
+void prefetch_group(HashTable* table, const char* const* keys, size_t n, uint64_t* hashes) {
+    for (size_t i = 0; i < n; i++) {
+        hashes[i] = table_hash(table, keys[i]);
+        if (table->backend == BACKEND_SWISS) {
+            size_t pos = swiss_h1(hashes[i], table->capacity);
+            __builtin_prefetch(table->ctrl + pos);
+            __builtin_prefetch(table->slots + pos);
+        } else {
+            __builtin_prefetch(&table->table[bucket_index(hashes[i], table->capacity)]);
+            HashNode** old = old_bucket(table, hashes[i]);
+            if (old) {
+                __builtin_prefetch(old);
+            }
         }
     }
-    free(table->table);
-    free(table);
 }
 
-int main() {
+// Function to insert count key-value pairs. Keys are processed BATCH_GROUP
+// at a time so the cache misses of a whole group overlap.
+void insert_batch(HashTable* table, const char* const* keys, const int* values, size_t count) {
+    uint64_t hashes[BATCH_GROUP];
+    
+    for (size_t base = 0; base < count; base += BATCH_GROUP) {
+        size_t n = count - base < BATCH_GROUP ? count - base : BATCH_GROUP;
+        
+        // Grow before prefetching so the prefetched lines stay valid
+        if (table->backend == BACKEND_SWISS) {
+            swiss_reserve(table, n);
+        } else {
+            migrate_buckets(table, MIGRATE_BUCKETS_PER_OP * n);
+            while ((double)(table->size + n) / table->capacity >= LOAD_FACTOR) {
+                resize_table(table);
+            }
+        }
+        
+        prefetch_group(table, keys + base, n, hashes);
+        
+        for (size_t i = 0; i < n; i++) {
+            if (table->backend == BACKEND_SWISS) {
+                swiss_insert_hashed(table, keys[base + i], hashes[i], values[base + i]);
+            } else {
+                insert_hashed(table, keys[base + i], hashes[i], values[base + i]);
+            }
+        }
+    }
+}
+
+// Function to look up count keys, storing each value (or -1) in values.
+// Each group goes through three passes: hash and prefetch the first line,
+// prefetch the next dependent line (chain head node or matching slot's
+// key), then resolve.
+void get_batch(HashTable* table, const char* const* keys, int* values, size_t count) {
+    uint64_t hashes[BATCH_GROUP];
+    
+    for (size_t base = 0; base < count; base += BATCH_GROUP) {
+        size_t n = count - base < BATCH_GROUP ? count - base : BATCH_GROUP;
+        
+        // Migrate before prefetching so the prefetched lines stay valid
+        if (table->backend == BACKEND_CHAINED) {
+            migrate_buckets(table, MIGRATE_BUCKETS_PER_OP * n);
+        }
+        
+        prefetch_group(table, keys + base, n, hashes);
+        
+        for (size_t i = 0; i < n; i++) {
+            if (table->backend == BACKEND_SWISS) {
+                size_t pos = swiss_h1(hashes[i], table->capacity);
+                uint32_t match = group_match(table->ctrl + pos, swiss_h2(hashes[i]));
+                if (match) {
+                    size_t index = (pos + __builtin_ctz(match)) & (table->capacity - 1);
+                    __builtin_prefetch(table->slots[index].key);
+                }
+            } else {
+                HashNode* head = table->table[bucket_index(hashes[i], table->capacity)];
+                if (head) {
+                    __builtin_prefetch(head);
+                }
+            }
+        }
+        
+        for (size_t i = 0; i < n; i++) {
+            if (table->backend == BACKEND_SWISS) {
+                size_t index = swiss_find(table, keys[base + i], hashes[i]);
+                values[base + i] = index == table->capacity ? -1 : table->slots[index].value;
+            } else {
+                values[base + i] = get_hashed(table, keys[base + i], hashes[i]);
+            }
+        }
+    }
+}
+
+// Function to print the hash table
+void print_table(HashTable* table) {
+    printf("\nHash Table Contents:\n");
+    if (table->backend == BACKEND_SWISS) {
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->ctrl[i] == CTRL_EMPTY) {
+                printf("Slot %zu: EMPTY\n", i);
+            } else {
+                printf("Slot %zu: [%s: %d]\n", i, table->slots[i].key, table->slots[i].value);
+            }
+        }
+        printf("\nTotal collisions: %zu\n", table->collisions);
+        return;
+    }
+    
+    finish_migration(table);
+    for (size_t i = 0; i < table->capacity; i++) {
+        printf("Bucket %zu: ", i);
+        HashNode* current = table->table[i];
+        while (current) {
+            printf("[%s: %d] -> ", current->key, current->value);
+            current = current->next;
+        }
+        printf("NULL\n");
+    }
+    printf("\nTotal collisions: %zu\n", table->collisions);
+}
+
+// Function to free the hash table
+void free_table(HashTable* table) {
+    // Keys and nodes live in the arena
+    arena_free(&table->arena);
+    free(table->ctrl);
+    free(table->slots);
+    free(table->old_table);
+    free(table->table);
+    free(table);
+}
+
+// Function to allocate a bucket array of the concurrent table
+CBucketArray* carray_alloc(size_t capacity) {
+    CBucketArray* array = (CBucketArray*)calloc(1, sizeof(CBucketArray) + capacity * sizeof(_Atomic(CNode*)));
+    if (!array) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    
+    array->capacity = capacity;
+    return array;
+}
+
+// Function to free a bucket array together with the nodes in its chains
+void carray_free(CBucketArray* array) {
+    for (size_t i = 0; i < array->capacity; i++) {
+        CNode* current = atomic_load_explicit(&array->buckets[i], memory_order_relaxed);
+        while (current) {
+            CNode* next = atomic_load_explicit(&current->next, memory_order_relaxed);
+            free(current);
+            current = next;
+        }
+    }
+    free(array);
+}
+
+// Function to create a node of the concurrent table with the key inline
+CNode* cnode_create(const char* key, uint64_t hash, int value) {
+    size_t length = strlen(key) + 1;
+    CNode* node = (CNode*)malloc(sizeof(CNode) + length);
+    if (!node) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    
+    memcpy(node->key, key, length);
+    node->hash = hash;
+    atomic_init(&node->value, value);
+    atomic_init(&node->next, NULL);
+    return node;
+}
+
+// Function to create a new concurrent hash table
+ConcurrentHashTable* create_concurrent_table() {
+    size_t bytes = (sizeof(ConcurrentHashTable) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    ConcurrentHashTable* table = (ConcurrentHashTable*)aligned_alloc(CACHE_LINE, bytes);
+    if (!table) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    
+    memset(table, 0, bytes);
+    table->hash = hash_wyhash;
+    size_t capacity = INITIAL_SIZE < CONCURRENT_STRIPES ? CONCURRENT_STRIPES : INITIAL_SIZE;
+    atomic_init(&table->current, carray_alloc(capacity));
+    atomic_init(&table->global_epoch, 0);
+    atomic_init(&table->thread_count, 0);
+    for (int i = 0; i < CONCURRENT_STRIPES; i++) {
+        pthread_mutex_init(&table->stripes[i].lock, NULL);
+    }
+    return table;
+}
+
+// Function to register the calling thread; the returned id is passed to
+// every operation the thread performs on the table
+int concurrent_register_thread(ConcurrentHashTable* table) {
+    size_t id = atomic_fetch_add(&table->thread_count, 1);
+    if (id >= CONCURRENT_MAX_THREADS) {
+        printf("Too many threads for concurrent table\n");
+        exit(1);
+    }
+    return (int)id;
+}
+
+// Function to mark the calling thread as reading shared nodes
+void epoch_enter(ConcurrentHashTable* table, int tid) {
+    EpochRecord* record = &table->records[tid];
+    atomic_store(&record->active, true);
+    atomic_store(&record->epoch, atomic_load(&table->global_epoch));
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+// Function to mark the calling thread as no longer reading shared nodes
+void epoch_exit(ConcurrentHashTable* table, int tid) {
+    atomic_store_explicit(&table->records[tid].active, false, memory_order_release);
+}
+
+// Function to free the retired objects of a thread that no reader can
+// still reach. The global epoch only advances once every active thread
+// has observed it, so anything retired two epochs ago is unreachable.
+void epoch_collect(ConcurrentHashTable* table, int tid) {
+    uint64_t epoch = atomic_load(&table->global_epoch);
+    bool all_caught_up = true;
+    size_t threads = atomic_load(&table->thread_count);
+    
+    for (size_t i = 0; i < threads && i < CONCURRENT_MAX_THREADS; i++) {
+        EpochRecord* other = &table->records[i];
+        if (atomic_load(&other->active) && atomic_load(&other->epoch) != epoch) {
+            all_caught_up = false;
+            break;
+        }
+    }
+    if (all_caught_up && atomic_compare_exchange_strong(&table->global_epoch, &epoch, epoch + 1)) {
+        epoch++;
+    }
+    
+    EpochRecord* record = &table->records[tid];
+    size_t kept = 0;
+    for (size_t i = 0; i < record->retired_count; i++) {
+        RetiredItem item = record->retired[i];
+        if (item.epoch + 2 > epoch) {
+            record->retired[kept++] = item;
+        } else if (item.is_array) {
+            carray_free((CBucketArray*)item.ptr);
+        } else {
+            free(item.ptr);
+        }
+    }
+    record->retired_count = kept;
+    record->collect_at = kept + EPOCH_RETIRE_THRESHOLD;
+}
+
+// Function to defer freeing a node or bucket array until no reader can
+// still hold a pointer to it
+void epoch_retire(ConcurrentHashTable* table, int tid, void* ptr, bool is_array) {
+    EpochRecord* record = &table->records[tid];
+    if (record->retired_count == record->retired_capacity) {
+        size_t capacity = record->retired_capacity ? record->retired_capacity * 2 : EPOCH_RETIRE_THRESHOLD;
+        RetiredItem* retired = (RetiredItem*)realloc(record->retired, capacity * sizeof(RetiredItem));
+        if (!retired) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        record->retired = retired;
+        record->retired_capacity = capacity;
+    }
+    
+    record->retired[record->retired_count].ptr = ptr;
+    record->retired[record->retired_count].epoch = atomic_load(&table->global_epoch);
+    record->retired[record->retired_count].is_array = is_array;
+    record->retired_count++;
+    
+    if (record->retired_count >= record->collect_at) {
+        epoch_collect(table, tid);
+    }
+}
+
+// Function to hash a key for the concurrent table
+uint64_t concurrent_hash(ConcurrentHashTable* table, const char* key) {
+    return table->hash(key, strlen(key));
+}
+
+// Function to copy the chains of stripe s into the next bucket array.
+// Nodes are cloned rather than relinked so readers still walking the old
+// chains are never redirected. The caller holds the stripe lock. Returns
+// true if this was the last stripe to move.
+bool migrate_stripe(CBucketArray* array, CBucketArray* next, size_t s) {
+    for (size_t i = s; i < array->capacity; i += CONCURRENT_STRIPES) {
+        CNode* current = atomic_load_explicit(&array->buckets[i], memory_order_relaxed);
+        while (current) {
+            CNode* copy = cnode_create(current->key, current->hash,
+                                       atomic_load_explicit(&current->value, memory_order_relaxed));
+            _Atomic(CNode*)* bucket = &next->buckets[bucket_index(current->hash, next->capacity)];
+            atomic_store_explicit(&copy->next, atomic_load_explicit(bucket, memory_order_relaxed),
+                                  memory_order_relaxed);
+            atomic_store_explicit(bucket, copy, memory_order_relaxed);
+            current = atomic_load_explicit(&current->next, memory_order_relaxed);
+        }
+    }
+    
+    atomic_store_explicit(&array->migrated[s], true, memory_order_release);
+    return atomic_fetch_add(&array->migrated_count, 1) + 1 == CONCURRENT_STRIPES;
+}
+
+// Function to publish the next bucket array once every stripe has moved
+void finish_concurrent_resize(ConcurrentHashTable* table, int tid, CBucketArray* array) {
+    atomic_store(&table->current, atomic_load(&array->next));
+    epoch_retire(table, tid, array, true);
+}
+
+// Function to find the bucket array writers of stripe s must use,
+// migrating the stripe forward first if a resize is in progress. The
+// caller holds the stripe lock.
+CBucketArray* writer_array(ConcurrentHashTable* table, int tid, size_t s) {
+    CBucketArray* array = atomic_load(&table->current);
+    CBucketArray* next;
+    
+    while ((next = atomic_load(&array->next))) {
+        if (!atomic_load_explicit(&array->migrated[s], memory_order_relaxed) &&
+            migrate_stripe(array, next, s)) {
+            finish_concurrent_resize(table, tid, array);
+        }
+        array = next;
+    }
+    return array;
+}
+
+// Function to find the bucket array readers of stripe s must use
+CBucketArray* reader_array(ConcurrentHashTable* table, size_t s) {
+    CBucketArray* array = atomic_load_explicit(&table->current, memory_order_acquire);
+    CBucketArray* next;
+    
+    while ((next = atomic_load_explicit(&array->next, memory_order_acquire)) &&
+           atomic_load_explicit(&array->migrated[s], memory_order_acquire)) {
+        array = next;
+    }
+    return array;
+}
+
+// Function to start a resize of array unless one is already running
+void start_concurrent_resize(ConcurrentHashTable* table, CBucketArray* array) {
+    if (atomic_load(&table->current) != array) {
+        return;
+    }
+    
+    CBucketArray* next = carray_alloc(array->capacity * GROWTH_FACTOR);
+    CBucketArray* expected = NULL;
+    if (!atomic_compare_exchange_strong(&array->next, &expected, next)) {
+        free(next);
+    }
+}
+
+// Function to let a writer move a few stripes of a running resize, so the
+// work is shared by all writers instead of stalling one of them
+void help_concurrent_resize(ConcurrentHashTable* table, int tid) {
+    CBucketArray* array = atomic_load(&table->current);
+    CBucketArray* next = atomic_load(&array->next);
+    if (!next) {
+        return;
+    }
+    
+    for (int n = 0; n < CONCURRENT_HELP_STRIPES; n++) {
+        size_t s = atomic_fetch_add(&array->migrate_cursor, 1);
+        if (s >= CONCURRENT_STRIPES) {
+            return;
+        }
+        
+        pthread_mutex_lock(&table->stripes[s].lock);
+        bool last = !atomic_load_explicit(&array->migrated[s], memory_order_relaxed) &&
+                    migrate_stripe(array, next, s);
+        pthread_mutex_unlock(&table->stripes[s].lock);
+        if (last) {
+            finish_concurrent_resize(table, tid, array);
+        }
+    }
+}
+
+// Function to insert a key-value pair into the concurrent table
+void concurrent_insert(ConcurrentHashTable* table, int tid, const char* key, int value) {
+    uint64_t hash = concurrent_hash(table, key);
+    size_t s = hash & (CONCURRENT_STRIPES - 1);
+    Stripe* stripe = &table->stripes[s];
+    
+    epoch_enter(table, tid);
+    pthread_mutex_lock(&stripe->lock);
+    
+    CBucketArray* array = writer_array(table, tid, s);
+    _Atomic(CNode*)* bucket = &array->buckets[bucket_index(hash, array->capacity)];
+    CNode* head = atomic_load_explicit(bucket, memory_order_relaxed);
+    
+    for (CNode* node = head; node; node = atomic_load_explicit(&node->next, memory_order_relaxed)) {
+        if (node->hash == hash && strcmp(node->key, key) == 0) {
+            atomic_store_explicit(&node->value, value, memory_order_release);
+            pthread_mutex_unlock(&stripe->lock);
+            epoch_exit(table, tid);
+            return;
+        }
+    }
+    
+    // Publish the fully initialized node with a release store
+    CNode* node = cnode_create(key, hash, value);
+    atomic_store_explicit(&node->next, head, memory_order_relaxed);
+    atomic_store_explicit(bucket, node, memory_order_release);
+    stripe->count++;
+    bool grow = (double)stripe->count * CONCURRENT_STRIPES / array->capacity >= LOAD_FACTOR;
+    
+    pthread_mutex_unlock(&stripe->lock);
+    
+    if (grow) {
+        start_concurrent_resize(table, array);
+    }
+    help_concurrent_resize(table, tid);
+    epoch_exit(table, tid);
+}
+
+// Function to get a value by key without taking any lock
+int concurrent_get(ConcurrentHashTable* table, int tid, const char* key) {
+    uint64_t hash = concurrent_hash(table, key);
+    int value = -1;
+    
+    epoch_enter(table, tid);
+    CBucketArray* array = reader_array(table, hash & (CONCURRENT_STRIPES - 1));
+    CNode* node = atomic_load_explicit(&array->buckets[bucket_index(hash, array->capacity)], memory_order_acquire);
+    
+    while (node) {
+        if (node->hash == hash && strcmp(node->key, key) == 0) {
+            value = atomic_load_explicit(&node->value, memory_order_acquire);
+            break;
+        }
+        node = atomic_load_explicit(&node->next, memory_order_acquire);
+    }
+    epoch_exit(table, tid);
+    
+    return value;
+}
+
+// Function to remove a key-value pair from the concurrent table
+void concurrent_remove(ConcurrentHashTable* table, int tid, const char* key) {
+    uint64_t hash = concurrent_hash(table, key);
+    size_t s = hash & (CONCURRENT_STRIPES - 1);
+    Stripe* stripe = &table->stripes[s];
+    
+    epoch_enter(table, tid);
+    pthread_mutex_lock(&stripe->lock);
+    
+    CBucketArray* array = writer_array(table, tid, s);
+    _Atomic(CNode*)* link = &array->buckets[bucket_index(hash, array->capacity)];
+    CNode* node = atomic_load_explicit(link, memory_order_relaxed);
+    
+    while (node) {
+        if (node->hash == hash && strcmp(node->key, key) == 0) {
+            // Readers already on the node can still follow its next pointer
+            atomic_store_explicit(link, atomic_load_explicit(&node->next, memory_order_relaxed),
+                                  memory_order_release);
+            stripe->count--;
+            epoch_retire(table, tid, node, false);
+            break;
+        }
+        link = &node->next;
+        node = atomic_load_explicit(link, memory_order_relaxed);
+    }
+    
+    pthread_mutex_unlock(&stripe->lock);
+    epoch_exit(table, tid);
+}
+
+// Function to free the concurrent table once all threads are done with it
+void free_concurrent_table(ConcurrentHashTable* table) {
+    for (int i = 0; i < CONCURRENT_MAX_THREADS; i++) {
+        EpochRecord* record = &table->records[i];
+        for (size_t j = 0; j < record->retired_count; j++) {
+            if (record->retired[j].is_array) {
+                carray_free((CBucketArray*)record->retired[j].ptr);
+            } else {
+                free(record->retired[j].ptr);
+            }
+        }
+        free(record->retired);
+    }
+    
+    CBucketArray* array = atomic_load(&table->current);
+    CBucketArray* next = atomic_load(&array->next);
+    carray_free(array);
+    if (next) {
+        carray_free(next);
+    }
+    
+    for (int i = 0; i < CONCURRENT_STRIPES; i++) {
+        pthread_mutex_destroy(&table->stripes[i].lock);
+    }
+    free(table);
+}
+
+// Function to round an offset up to a multiple of align
+uint64_t align_offset(uint64_t offset, uint64_t align) {
+    return (offset + align - 1) & ~(align - 1);
+}
+
+// Function to checksum a header with its checksum field cleared
+uint64_t snapshot_header_checksum(const SnapshotHeader* header) {
+    SnapshotHeader copy = *header;
+    copy.header_checksum = 0;
+    return hash_wyhash((const char*)&copy, sizeof(copy));
+}
+
+// Function to place one key into the snapshot image being built
+void snapshot_put(uint8_t* image, SnapshotHeader* header, const char* key, int value,
+                  uint64_t* key_cursor) {
+    int8_t* ctrl = (int8_t*)(image + header->ctrl_offset);
+    SnapshotSlot* slots = (SnapshotSlot*)(image + header->slots_offset);
+    size_t length = strlen(key);
+    uint64_t hash = hash_wyhash(key, length);
+    size_t mask = header->capacity - 1;
+    size_t pos = swiss_h1(hash, header->capacity);
+    uint32_t empty;
+    
+    while (!(empty = group_match_empty(ctrl + pos))) {
+        pos = (pos + GROUP_WIDTH) & mask;
+    }
+    size_t index = (pos + __builtin_ctz(empty)) & mask;
+    
+    ctrl[index] = swiss_h2(hash);
+    if (index < GROUP_WIDTH) {
+        ctrl[header->capacity + index] = swiss_h2(hash);
+    }
+    slots[index].key_offset = *key_cursor;
+    slots[index].hash = hash;
+    slots[index].value = value;
+    slots[index].key_length = (uint32_t)length;
+    
+    memcpy(image + header->keys_offset + *key_cursor, key, length + 1);
+    *key_cursor += length + 1;
+}
+
+// Function to write the table to path as a snapshot that load_table can
+// map without deserializing. Whatever the backend, the image uses the
+// Swiss layout keyed by wyhash. The file is written under a temporary
+// name and renamed into place, so readers never see a partial image.
+bool save_table(HashTable* table, const char* path) {
+    if (table->backend == BACKEND_CHAINED) {
+        finish_migration(table);
+    }
+    
+    // Size the image: open addressing at the Swiss load factor
+    size_t capacity = GROUP_WIDTH;
+    while (table->size * SWISS_MAX_LOAD_DEN >= capacity * SWISS_MAX_LOAD_NUM) {
+        capacity *= 2;
+    }
+    uint64_t keys_size = 0;
+    if (table->backend == BACKEND_SWISS) {
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->ctrl[i] != CTRL_EMPTY) {
+                keys_size += strlen(table->slots[i].key) + 1;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < table->capacity; i++) {
+            for (HashNode* node = table->table[i]; node; node = node->next) {
+                keys_size += strlen(node->key) + 1;
+            }
+        }
+    }
+    
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.hash_id = SNAPSHOT_HASH_WYHASH;
+    header.capacity = capacity;
+    header.size = table->size;
+    header.ctrl_offset = align_offset(sizeof(SnapshotHeader), CACHE_LINE);
+    header.slots_offset = align_offset(header.ctrl_offset + capacity + GROUP_WIDTH, CACHE_LINE);
+    header.keys_offset = align_offset(header.slots_offset + capacity * sizeof(SnapshotSlot), CACHE_LINE);
+    header.keys_size = keys_size;
+    header.file_size = header.keys_offset + keys_size;
+    
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        printf("Snapshot path too long\n");
+        return false;
+    }
+    
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Failed to create snapshot");
+        return false;
+    }
+    if (ftruncate(fd, (off_t)header.file_size) < 0) {
+        perror("Failed to size snapshot");
+        close(fd);
+        unlink(tmp_path);
+        return false;
+    }
+    uint8_t* image = (uint8_t*)mmap(NULL, header.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (image == MAP_FAILED) {
+        perror("Failed to map snapshot");
+        close(fd);
+        unlink(tmp_path);
+        return false;
+    }
+    
+    memset(image + header.ctrl_offset, CTRL_EMPTY, capacity + GROUP_WIDTH);
+    uint64_t key_cursor = 0;
+    if (table->backend == BACKEND_SWISS) {
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->ctrl[i] != CTRL_EMPTY) {
+                snapshot_put(image, &header, table->slots[i].key, table->slots[i].value, &key_cursor);
+            }
+        }
+    } else {
+        for (size_t i = 0; i < table->capacity; i++) {
+            for (HashNode* node = table->table[i]; node; node = node->next) {
+                snapshot_put(image, &header, node->key, node->value, &key_cursor);
+            }
+        }
+    }
+    
+    header.body_checksum = hash_wyhash((const char*)image + sizeof(SnapshotHeader),
+                                       header.file_size - sizeof(SnapshotHeader));
+    header.header_checksum = snapshot_header_checksum(&header);
+    memcpy(image, &header, sizeof(header));
+    
+    bool ok = msync(image, header.file_size, MS_SYNC) == 0;
+    munmap(image, header.file_size);
+    ok = fsync(fd) == 0 && ok;
+    close(fd);
+    if (!ok || rename(tmp_path, path) < 0) {
+        perror("Failed to write snapshot");
+        unlink(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+// Function to map a snapshot written by save_table. The header and the
+// layout it describes are always validated; verify_body additionally
+// checksums the whole file, which reads every page once. Returns NULL for
+// missing, foreign, truncated or corrupted files.
+MappedHashTable* load_table(const char* path, bool verify_body) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open snapshot");
+        return NULL;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        printf("Snapshot too small\n");
+        close(fd);
+        return NULL;
+    }
+    
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("Failed to map snapshot");
+        return NULL;
+    }
+    
+    const SnapshotHeader* header = (const SnapshotHeader*)map;
+    const char* error = NULL;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+        error = "not a hash table snapshot";
+    } else if (header->version != SNAPSHOT_VERSION) {
+        error = "unsupported snapshot version";
+    } else if (header->header_checksum != snapshot_header_checksum(header)) {
+        error = "header checksum mismatch";
+    } else if (header->hash_id != SNAPSHOT_HASH_WYHASH ||
+               header->file_size != (uint64_t)st.st_size ||
+               header->capacity < GROUP_WIDTH ||
+               header->capacity > header->file_size ||
+               (header->capacity & (header->capacity - 1)) != 0 ||
+               header->size >= header->capacity ||
+               header->slots_offset > header->file_size ||
+               header->ctrl_offset < sizeof(SnapshotHeader) ||
+               header->ctrl_offset > header->slots_offset ||
+               header->capacity + GROUP_WIDTH > header->slots_offset - header->ctrl_offset ||
+               header->capacity > (header->file_size - header->slots_offset) / sizeof(SnapshotSlot) ||
+               header->keys_offset < header->slots_offset ||
+               header->capacity * sizeof(SnapshotSlot) > header->keys_offset - header->slots_offset ||
+               header->keys_offset > header->file_size ||
+               header->keys_size != header->file_size - header->keys_offset ||
+               header->slots_offset % _Alignof(SnapshotSlot) != 0) {
+        error = "inconsistent snapshot layout";
+    } else if (verify_body &&
+               header->body_checksum != hash_wyhash((const char*)map + sizeof(SnapshotHeader),
+                                                    header->file_size - sizeof(SnapshotHeader))) {
+        error = "body checksum mismatch";
+    }
+    if (error) {
+        printf("Rejected snapshot %s: %s\n", path, error);
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    
+    MappedHashTable* table = (MappedHashTable*)malloc(sizeof(MappedHashTable));
+    if (!table) {
+        printf("Memory allocation failed\n");
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    
+    table->map = map;
+    table->map_size = (size_t)st.st_size;
+    table->header = header;
+    table->ctrl = (const int8_t*)((const char*)map + header->ctrl_offset);
+    table->slots = (const SnapshotSlot*)((const char*)map + header->slots_offset);
+    table->keys = (const char*)map + header->keys_offset;
+    return table;
+}
+
+// Function to get a value by key from a mapped snapshot
+int mapped_get(MappedHashTable* table, const char* key) {
+    size_t length = strlen(key);
+    uint64_t hash = hash_wyhash(key, length);
+    size_t capacity = table->header->capacity;
+    size_t mask = capacity - 1;
+    size_t pos = swiss_h1(hash, capacity);
+    int8_t h2 = swiss_h2(hash);
+    
+    // Bounded so a damaged control array without empty slots cannot hang
+    for (size_t probes = 0; probes <= capacity / GROUP_WIDTH; probes++) {
+        const int8_t* group = table->ctrl + pos;
+        uint32_t match = group_match(group, h2);
+        while (match) {
+            const SnapshotSlot* slot = &table->slots[(pos + __builtin_ctz(match)) & mask];
+            if (slot->hash == hash && slot->key_length == length &&
+                slot->key_offset < table->header->keys_size &&
+                length < table->header->keys_size - slot->key_offset &&
+                memcmp(table->keys + slot->key_offset, key, length) == 0) {
+                return slot->value;
+            }
+            match &= match - 1;
+        }
+        if (group_match_empty(group)) {
+            return -1;
+        }
+        pos = (pos + GROUP_WIDTH) & mask;
+    }
+    return -1;
+}
+
+// Function to unmap a snapshot
+void unload_table(MappedHashTable* table) {
+    if (table) {
+        munmap(table->map, table->map_size);
+        free(table);
+    }
+}
+
+// Function to read a monotonic clock in seconds
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Function to advance a xorshift64 generator
+uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Function to build count keys of BENCH_KEY_STRIDE bytes each in one block
+char* make_bench_keys(const char* prefix, size_t count) {
+    char* keys = (char*)malloc(count * BENCH_KEY_STRIDE);
+    if (!keys) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        snprintf(keys + i * BENCH_KEY_STRIDE, BENCH_KEY_STRIDE, "%s%u", prefix, (unsigned)i);
+    }
+    return keys;
+}
+
+// Function to time insert/get/remove_key on one backend
+void benchmark_backend(HashBackend backend, const char* keys, const char* miss_keys,
+                       size_t count, size_t miss_count) {
+    HashTable* table = create_hash_table_with_backend(backend);
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    long long checksum = 0;
+    
+    double start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        insert(table, keys + i * BENCH_KEY_STRIDE, (int)i);
+    }
+    double insert_time = now_seconds() - start;
+    
+    start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        checksum += get(table, keys + (next_random(&rng) % count) * BENCH_KEY_STRIDE);
+    }
+    double hit_time = now_seconds() - start;
+    
+    start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        checksum += get(table, miss_keys + (next_random(&rng) % miss_count) * BENCH_KEY_STRIDE);
+    }
+    double miss_time = now_seconds() - start;
+    
+    start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        remove_key(table, keys + i * BENCH_KEY_STRIDE);
+    }
+    double remove_time = now_seconds() - start;
+    
+    printf("%-8s %12zu %10.1f %10.1f %10.1f %10.1f   (checksum %lld)\n",
+           backend == BACKEND_SWISS ? "swiss" : "chained", count,
+           insert_time * 1e9 / count, hit_time * 1e9 / count,
+           miss_time * 1e9 / count, remove_time * 1e9 / count, checksum);
+    
+    free_table(table);
+}
+
+// Function to time scalar and batched inserts and lookups on one backend
+void benchmark_batch_backend(HashBackend backend, const char* const* keys, const int* values,
+                             const char* const* lookups, size_t count) {
+    int* results = (int*)malloc(count * sizeof(int));
+    if (!results) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    
+    HashTable* scalar = create_hash_table_with_backend(backend);
+    double start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        insert(scalar, keys[i], values[i]);
+    }
+    double insert_scalar = now_seconds() - start;
+    
+    HashTable* batched = create_hash_table_with_backend(backend);
+    start = now_seconds();
+    insert_batch(batched, keys, values, count);
+    double insert_batched = now_seconds() - start;
+    free_table(batched);
+    
+    long long checksum = 0;
+    start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        results[i] = get(scalar, lookups[i]);
+    }
+    double get_scalar = now_seconds() - start;
+    for (size_t i = 0; i < count; i++) {
+        checksum += results[i];
+    }
+    
+    start = now_seconds();
+    get_batch(scalar, lookups, results, count);
+    double get_batched = now_seconds() - start;
+    for (size_t i = 0; i < count; i++) {
+        checksum -= results[i];
+    }
+    
+    printf("%-8s %12zu %10.1f %10.1f %8.2fx %10.1f %10.1f %8.2fx%s\n",
+           backend == BACKEND_SWISS ? "swiss" : "chained", count,
+           insert_scalar * 1e9 / count, insert_batched * 1e9 / count, insert_scalar / insert_batched,
+           get_scalar * 1e9 / count, get_batched * 1e9 / count, get_scalar / get_batched,
+           checksum ? "   RESULT MISMATCH" : "");
+    
+    free_table(scalar);
+    free(results);
+}
+
+// Function to compare the batch API against scalar loops. The default key
+// count gives a working set of several hundred MB, well beyond the LLC.
+int run_batch_benchmark(int argc, char** argv) {
+    size_t count = argc > 0 ? strtoull(argv[0], NULL, 10) : BATCH_BENCH_KEYS;
+    if (count == 0) {
+        printf("Invalid key count: %s\n", argv[0]);
+        return 1;
+    }
+    
+    char* key_block = make_bench_keys("key", count);
+    const char** keys = (const char**)malloc(count * sizeof(char*));
+    const char** lookups = (const char**)malloc(count * sizeof(char*));
+    int* values = (int*)malloc(count * sizeof(int));
+    if (!keys || !lookups || !values) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = key_block + i * BENCH_KEY_STRIDE;
+        lookups[i] = key_block + (next_random(&rng) % count) * BENCH_KEY_STRIDE;
+        values[i] = (int)i;
+    }
+    
+    printf("%-8s %12s %10s %10s %9s %10s %10s %9s   (ns/key)\n",
+           "backend", "keys", "insert", "batch", "speedup", "get", "batch", "speedup");
+    benchmark_batch_backend(BACKEND_CHAINED, keys, values, lookups, count);
+    benchmark_batch_backend(BACKEND_SWISS, keys, values, lookups, count);
+    
+    free(key_block);
+    free(keys);
+    free(lookups);
+    free(values);
+    return 0;
+}
+
+// Function to compare rebuilding a table through insert with saving it
+// and mapping the snapshot back, then check that damage is rejected
+int run_snapshot_benchmark(int argc, char** argv) {
+    size_t count = argc > 0 ? strtoull(argv[0], NULL, 10) : SNAPSHOT_BENCH_KEYS;
+    const char* path = argc > 1 ? argv[1] : SNAPSHOT_BENCH_PATH;
+    if (count == 0) {
+        printf("Invalid key count: %s\n", argv[0]);
+        return 1;
+    }
+    
+    char* keys = make_bench_keys("key", count);
+    
+    double start = now_seconds();
+    HashTable* table = create_hash_table();
+    for (size_t i = 0; i < count; i++) {
+        insert(table, keys + i * BENCH_KEY_STRIDE, (int)i);
+    }
+    printf("Rebuild via insert:   %8.3f s\n", now_seconds() - start);
+    
+    start = now_seconds();
+    bool saved = save_table(table, path);
+    free_table(table);
+    if (!saved) {
+        free(keys);
+        return 1;
+    }
+    printf("save_table:           %8.3f s\n", now_seconds() - start);
+    
+    for (int verify = 0; verify <= 1; verify++) {
+        start = now_seconds();
+        MappedHashTable* mapped = load_table(path, verify);
+        if (!mapped) {
+            free(keys);
+            return 1;
+        }
+        double load_time = now_seconds() - start;
+        
+        // First pass takes the page faults, second runs warm
+        size_t wrong = 0;
+        start = now_seconds();
+        for (size_t i = 0; i < count; i++) {
+            wrong += mapped_get(mapped, keys + i * BENCH_KEY_STRIDE) != (int)i;
+        }
+        double cold = now_seconds() - start;
+        start = now_seconds();
+        for (size_t i = 0; i < count; i++) {
+            wrong += mapped_get(mapped, keys + i * BENCH_KEY_STRIDE) != (int)i;
+        }
+        double warm = now_seconds() - start;
+        
+        printf("load_table(verify=%d): %8.3f s, first lookup pass %.3f s, warm pass %.3f s, %zu wrong\n",
+               verify, load_time, cold, warm, wrong);
+        unload_table(mapped);
+    }
+    
+    // Flip one byte in the middle of the body and expect a rejection
+    int fd = open(path, O_RDWR);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0) {
+        off_t offset = st.st_size / 2;
+        unsigned char byte;
+        if (pread(fd, &byte, 1, offset) == 1) {
+            byte ^= 0xFF;
+            if (pwrite(fd, &byte, 1, offset) == 1) {
+                MappedHashTable* damaged = load_table(path, true);
+                printf("Corrupted snapshot %s\n", damaged ? "was ACCEPTED" : "was rejected");
+                unload_table(damaged);
+            }
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    unlink(path);
+    
+    free(keys);
+    return 0;
+}
+
+// Function to compare two doubles for qsort
+int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Worst insert of each resize window of a latency run. A full resize's
+// window is the one insert that rehashes; an incremental one's runs until
+// its migration has finished.
+typedef struct {
+    size_t resizes;
+    size_t capacity[LATENCY_MAX_RESIZES];
+    size_t inserts[LATENCY_MAX_RESIZES];
+    double worst[LATENCY_MAX_RESIZES];
+    double outside_worst;  // Worst insert outside any window
+} ResizeStalls;
+
+// Function to record the latency of every insert into a chained table,
+// print its percentiles and collect the worst insert of each resize
+void measure_insert_latency(const char* keys, size_t count, bool incremental, ResizeStalls* stalls) {
+    HashTable* table = create_hash_table();
+    if (incremental) {
+        enable_incremental_resize(table);
+    }
+    
+    double* latencies = (double*)malloc(count * sizeof(double));
+    if (!latencies) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    
+    memset(stalls, 0, sizeof(*stalls));
+    for (size_t i = 0; i < count; i++) {
+        size_t capacity = table->capacity;
+        bool migrating = table->old_table != NULL;
+        double start = now_seconds();
+        insert(table, keys + i * BENCH_KEY_STRIDE, (int)i);
+        latencies[i] = (now_seconds() - start) * 1e6;
+        
+        size_t r = stalls->resizes;
+        if (table->capacity != capacity && r < LATENCY_MAX_RESIZES) {
+            stalls->capacity[r] = table->capacity;
+            stalls->inserts[r] = 1;
+            stalls->worst[r] = latencies[i];
+            stalls->resizes++;
+        } else if (migrating && r > 0) {
+            stalls->inserts[r - 1]++;
+            if (latencies[i] > stalls->worst[r - 1]) {
+                stalls->worst[r - 1] = latencies[i];
+            }
+        } else if (latencies[i] > stalls->outside_worst) {
+            stalls->outside_worst = latencies[i];
+        }
+    }
+    
+    qsort(latencies, count, sizeof(double), compare_doubles);
+    printf("%-12s %12zu %10.2f %10.2f %10.2f %12.2f\n",
+           incremental ? "incremental" : "full", count,
+           latencies[count / 2], latencies[(size_t)(count * 0.99)],
+           latencies[(size_t)(count * 0.999)], latencies[count - 1]);
+    
+    free(latencies);
+    free_table(table);
+}
+
+// Function to compare insert tail latency of full and incremental resizing.
+// A run of n inserts has only about log2(n) resizes, far too few to reach
+// p99 or p999, so the stall a resize causes shows in the per-resize table
+// and in max. Incremental resizing raises p99 and p999 instead: about a
+// third of all inserts fall inside a migration, and each of those probes
+// the old array too and moves MIGRATE_BUCKETS_PER_OP buckets, missing the
+// cache on both arrays. Stalls that remain outside any resize window, in
+// both modes, come from the machine (page faults, interrupts, preemption)
+// rather than the table.
+int run_latency_harness(int argc, char** argv) {
+    size_t count = argc > 0 ? strtoull(argv[0], NULL, 10) : LATENCY_DEFAULT_KEYS;
+    if (count == 0) {
+        printf("Invalid key count: %s\n", argv[0]);
+        return 1;
+    }
+    
+    char* keys = make_bench_keys("key", count);
+    
+    ResizeStalls full;
+    ResizeStalls incremental;
+    printf("%-12s %12s %10s %10s %10s %12s   (insert latency, us)\n",
+           "resize", "keys", "p50", "p99", "p999", "max");
+    measure_insert_latency(keys, count, false, &full);
+    measure_insert_latency(keys, count, true, &incremental);
+    
+    // Both runs insert the same keys, so they resize at the same points
+    printf("\n%-12s %12s %12s %12s   (worst insert per resize, us)\n",
+           "capacity", "full", "incremental", "window");
+    for (size_t r = 0; r < full.resizes && r < incremental.resizes; r++) {
+        printf("%-12zu %12.2f %12.2f %12zu\n", full.capacity[r], full.worst[r],
+               incremental.worst[r], incremental.inserts[r]);
+    }
+    printf("%-12s %12.2f %12.2f %12s\n", "no resize", full.outside_worst,
+           incremental.outside_worst, "-");
+    
+    free(keys);
+    return 0;
+}
+
+// Function to compare the chained and Swiss backends at several key counts
+int run_backend_benchmark(int argc, char** argv) {
+    size_t default_counts[] = {1000000, 10000000, 100000000};
+    size_t num_counts = argc > 0 ? (size_t)argc : sizeof(default_counts) / sizeof(default_counts[0]);
+    
+    printf("%-8s %12s %10s %10s %10s %10s   (ns/op)\n",
+           "backend", "keys", "insert", "get hit", "get miss", "remove");
+    
+    for (size_t c = 0; c < num_counts; c++) {
+        size_t count = argc > 0 ? strtoull(argv[c], NULL, 10) : default_counts[c];
+        if (count == 0) {
+            printf("Invalid key count: %s\n", argv[c]);
+            return 1;
+        }
+        size_t miss_count = count < BENCH_MISS_KEYS ? count : BENCH_MISS_KEYS;
+        
+        char* keys = make_bench_keys("key", count);
+        char* miss_keys = make_bench_keys("miss", miss_count);
+        
+        benchmark_backend(BACKEND_CHAINED, keys, miss_keys, count, miss_count);
+        benchmark_backend(BACKEND_SWISS, keys, miss_keys, count, miss_count);
+        
+        free(keys);
+        free(miss_keys);
+    }
+    
+    return 0;
+}
+
+// Function to time one hash function over keys of the given lengths
+double time_hash(HashFunc hash, const char* keys, const size_t* lengths, size_t count) {
+    uint64_t sink = 0;
+    double start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        sink += hash(keys + i * HASH_BENCH_MAX_LENGTH, lengths[i]);
+    }
+    double elapsed = now_seconds() - start;
+    
+    // Keep the compiler from dropping the loop
+    volatile uint64_t keep = sink;
+    (void)keep;
+    return elapsed * 1e9 / count;
+}
+
+// Function to time bucket index reductions
+void time_reductions(size_t count) {
+    const char* names[] = {"modulo", "mask", "fastrange"};
+    volatile size_t capacity = 1 << 20;
+    
+    for (int r = 0; r < 3; r++) {
+        uint64_t rng = 0x9E3779B97F4A7C15ULL;
+        size_t cap = capacity;
+        size_t sink = 0;
+        double start = now_seconds();
+        for (size_t i = 0; i < count; i++) {
+            uint64_t hash = next_random(&rng);
+            if (r == 0) {
+                sink += hash % cap;
+            } else if (r == 1) {
+                sink += bucket_index(hash, cap);
+            } else {
+                sink += fastrange(hash, cap);
+            }
+        }
+        double elapsed = now_seconds() - start;
+        volatile size_t keep = sink;
+        (void)keep;
+        printf("%-12s %10.2f ns/index (includes RNG)\n", names[r], elapsed * 1e9 / count);
+    }
+}
+
+// Function to report ns/key of each hash function across key lengths
+int run_hash_benchmark(int argc, char** argv) {
+    size_t count = argc > 0 ? strtoull(argv[0], NULL, 10) : HASH_BENCH_KEYS;
+    if (count == 0) {
+        printf("Invalid key count: %s\n", argv[0]);
+        return 1;
+    }
+    
+    // Fixed lengths, then uniform 1-16 and 1-64 (0 marks a uniform range)
+    size_t fixed[] = {4, 8, 16, 32, 64, 128, 256, 0, 0};
+    size_t uniform_max[] = {0, 0, 0, 0, 0, 0, 0, 16, 64};
+    HashFunc funcs[] = {hash_djb2, hash_djb2_mixed, hash_wyhash};
+    const char* names[] = {"djb2", "djb2+mix", "wyhash"};
+    
+    char* keys = (char*)malloc(count * HASH_BENCH_MAX_LENGTH);
+    size_t* lengths = (size_t*)malloc(count * sizeof(size_t));
+    if (!keys || !lengths) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    uint64_t rng = 42;
+    for (size_t i = 0; i < count * HASH_BENCH_MAX_LENGTH; i++) {
+        keys[i] = 'a' + next_random(&rng) % 26;
+    }
+    
+    printf("%-10s %12s %12s %12s   (ns/key)\n", "length", names[0], names[1], names[2]);
+    for (size_t d = 0; d < sizeof(fixed) / sizeof(fixed[0]); d++) {
+        char label[24];
+        for (size_t i = 0; i < count; i++) {
+            lengths[i] = fixed[d] ? fixed[d] : 1 + next_random(&rng) % uniform_max[d];
+        }
+        if (fixed[d]) {
+            snprintf(label, sizeof(label), "%zu", fixed[d]);
+        } else {
+            snprintf(label, sizeof(label), "1-%zu", uniform_max[d]);
+        }
+        
+        printf("%-10s", label);
+        for (int f = 0; f < 3; f++) {
+            printf(" %12.2f", time_hash(funcs[f], keys, lengths, count));
+        }
+        printf("\n");
+    }
+    
+    printf("\n");
+    time_reductions(count * 10);
+    
+    free(keys);
+    free(lengths);
+    return 0;
+}
+
+// Mutex-wrapped HashTable, the baseline for the concurrent benchmark
+typedef struct {
+    HashTable* table;
+    pthread_mutex_t lock;
+} LockedHashTable;
+
+// Arguments of one concurrent benchmark thread
+typedef struct {
+    ConcurrentHashTable* concurrent;
+    LockedHashTable* locked;
+    const char* keys;
+    size_t key_count;
+    size_t ops;
+    uint64_t seed;
+    long long checksum;
+} ConcurrentBenchArgs;
+
+// Function to run a 90% get / 5% insert / 5% remove mix on one table
+void* concurrent_bench_worker(void* arg) {
+    ConcurrentBenchArgs* args = (ConcurrentBenchArgs*)arg;
+    int tid = args->concurrent ? concurrent_register_thread(args->concurrent) : 0;
+    uint64_t rng = args->seed;
+    
+    for (size_t i = 0; i < args->ops; i++) {
+        uint64_t r = next_random(&rng);
+        const char* key = args->keys + (r >> 8) % args->key_count * BENCH_KEY_STRIDE;
+        int op = (int)(r & 0xFF) % 20;
+        
+        if (args->concurrent) {
+            if (op == 0) {
+                concurrent_insert(args->concurrent, tid, key, (int)i);
+            } else if (op == 1) {
+                concurrent_remove(args->concurrent, tid, key);
+            } else {
+                args->checksum += concurrent_get(args->concurrent, tid, key);
+            }
+        } else {
+            pthread_mutex_lock(&args->locked->lock);
+            if (op == 0) {
+                insert(args->locked->table, key, (int)i);
+            } else if (op == 1) {
+                remove_key(args->locked->table, key);
+            } else {
+                args->checksum += get(args->locked->table, key);
+            }
+            pthread_mutex_unlock(&args->locked->lock);
+        }
+    }
+    return NULL;
+}
+
+// Function to time one thread count on a freshly filled table
+double concurrent_bench_run(bool use_concurrent, const char* keys, size_t key_count,
+                            size_t total_ops, int threads) {
+    ConcurrentHashTable* concurrent = NULL;
+    LockedHashTable locked = {NULL, PTHREAD_MUTEX_INITIALIZER};
+    
+    // Prefill half of the key space so about half of the gets hit
+    if (use_concurrent) {
+        concurrent = create_concurrent_table();
+        int tid = concurrent_register_thread(concurrent);
+        for (size_t i = 0; i < key_count / 2; i++) {
+            concurrent_insert(concurrent, tid, keys + i * BENCH_KEY_STRIDE, (int)i);
+        }
+    } else {
+        locked.table = create_hash_table();
+        for (size_t i = 0; i < key_count / 2; i++) {
+            insert(locked.table, keys + i * BENCH_KEY_STRIDE, (int)i);
+        }
+    }
+    
+    pthread_t workers[CONCURRENT_BENCH_THREADS];
+    ConcurrentBenchArgs args[CONCURRENT_BENCH_THREADS];
+    
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        args[i].concurrent = concurrent;
+        args[i].locked = &locked;
+        args[i].keys = keys;
+        args[i].key_count = key_count;
+        args[i].ops = total_ops / threads;
+        args[i].seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+        args[i].checksum = 0;
+        pthread_create(&workers[i], NULL, concurrent_bench_worker, &args[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    double elapsed = now_seconds() - start;
+    
+    if (concurrent) {
+        free_concurrent_table(concurrent);
+    } else {
+        free_table(locked.table);
+        pthread_mutex_destroy(&locked.lock);
+    }
+    
+    return (double)(total_ops / threads * threads) / elapsed / 1e6;
+}
+
+// Function to compare the concurrent table with a mutex-wrapped HashTable
+// from 1 up to max_threads threads
+int run_concurrent_benchmark(int argc, char** argv) {
+    int max_threads = argc > 0 ? atoi(argv[0]) : CONCURRENT_BENCH_THREADS;
+    size_t key_count = argc > 1 ? strtoull(argv[1], NULL, 10) : CONCURRENT_BENCH_KEYS;
+    size_t total_ops = argc > 2 ? strtoull(argv[2], NULL, 10) : CONCURRENT_BENCH_OPS;
+    
+    if (max_threads < 1 || max_threads > CONCURRENT_BENCH_THREADS || key_count < 2 || total_ops == 0) {
+        printf("Usage: concurrent [threads 1-%d] [keys] [total ops]\n", CONCURRENT_BENCH_THREADS);
+        return 1;
+    }
+    
+    char* keys = make_bench_keys("key", key_count);
+    
+    printf("%8s %14s %14s   (Mops/s, 90%% get / 5%% insert / 5%% remove)\n",
+           "threads", "global mutex", "concurrent");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double locked = concurrent_bench_run(false, keys, key_count, total_ops, threads);
+        double concurrent = concurrent_bench_run(true, keys, key_count, total_ops, threads);
+        printf("%8d %14.2f %14.2f\n", threads, locked, concurrent);
+        if (threads < max_threads && threads * 2 > max_threads) {
+            threads = max_threads / 2;
+        }
+    }
+    
+    free(keys);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // "bench [key counts...]" compares the two backends instead of the demo
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return run_backend_benchmark(argc - 2, argv + 2);
+    }
+    // "latency [key count]" reports insert percentiles for both resize modes
+    if (argc > 1 && strcmp(argv[1], "latency") == 0) {
+        return run_latency_harness(argc - 2, argv + 2);
+    }
+    // "concurrent [max threads] [keys] [total ops]" measures thread scaling
+    if (argc > 1 && strcmp(argv[1], "concurrent") == 0) {
+        return run_concurrent_benchmark(argc - 2, argv + 2);
+    }
+    // "batch [keys]" compares insert_batch/get_batch with scalar loops
+    if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+        return run_batch_benchmark(argc - 2, argv + 2);
+    }
+    // "snapshot [keys] [path]" compares rebuilding with save_table/load_table
+    if (argc > 1 && strcmp(argv[1], "snapshot") == 0) {
+        return run_snapshot_benchmark(argc - 2, argv + 2);
+    }
+    // "hashes [keys]" reports ns/key of each hash function
+    if (argc > 1 && strcmp(argv[1], "hashes") == 0) {
+        return run_hash_benchmark(argc - 2, argv + 2);
+    }
+    
     HashTable* table = create_hash_table();
     
     // Insert some key-value pairs
@@ -3,12 +3,69 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <execinfo.h>
 
 #define POOL_SIZE (1024 * 1024)  // 1MB pool
 #define ALIGNMENT 8
 #define MIN_BLOCK_SIZE 16
 #define MAX_BLOCKS 1000
 
+// Segregated-fit size classes: two per power of two (16, 24, 32, 48, 64,
+// 96, ...), so one 64-bit bitmap covers every block size
+#define NUM_SIZE_CLASSES 64
+
+// Growable pools map chunks of at least this size on demand
+#define DEFAULT_CHUNK_SIZE (1024 * 1024)
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+// Footer value marking the start of a chunk, so coalescing stops there
+#define CHUNK_FENCE SIZE_MAX
+
+// Sampled allocation call stacks: the last SAMPLE_SLOTS samples are kept,
+// each with up to SAMPLE_MAX_FRAMES return addresses
+#define SAMPLE_SLOTS 64
+#define SAMPLE_MAX_FRAMES 16
+
+// Churn benchmark parameters
+#define CHURN_POOL_SIZE (64 * 1024 * 1024)
+#define CHURN_DEFAULT_OPS 200000
+#define CHURN_DEFAULT_LIVE 20000
+#define CHURN_MAX_REQUEST 512
+#define FRAG_SAMPLES 20
+
+// Thread caches: requests up to CACHE_MAX_REQUEST bytes are served from
+// per-thread magazines, one per size class, which move MAGAZINE_BATCH
+// blocks at a time to and from the shared pool
+#define CACHE_LINE 64
+#define CACHE_MAX_REQUEST 1024
+#define CACHED_CLASSES 13  // size_class_ceil(CACHE_MAX_REQUEST) + 1
+#define MAGAZINE_CAPACITY 64
+#define MAGAZINE_BATCH 32
+// Return queue head of a detached cache; pushers that see it free to the
+// shared pool instead
+#define RETURN_QUEUE_CLOSED ((BlockHeader*)1)
+
+// Thread scaling benchmark parameters
+#define THREADS_POOL_SIZE (256 * 1024 * 1024)
+#define THREADS_MAX 64
+#define THREADS_DEFAULT_MAX 16
+#define THREADS_DEFAULT_OPS 500000  // per thread
+#define THREADS_LIVE 1024           // per thread
+#define THREADS_MAX_REQUEST 256
+#define THREADS_EXCHANGE_SLOTS 256
+
+// Stats benchmark parameters
+#define STATS_DEFAULT_PERIOD 1000
+#define STATS_EXPORT_INTERVAL_NS 1000000
+
+// Growth benchmark parameters
+#define GROW_DEFAULT_BLOCKS 200000
+#define GROW_KEEP_EVERY 16
+
 // Block header structure
 typedef struct BlockHeader {
     size_t size;
@@ -17,13 +74,85 @@ typedef struct BlockHeader {
     struct BlockHeader* prev;
 } BlockHeader;
 
+// Block footer (boundary tag) stored after every block's payload, so the
+// block physically before any header can be found in O(1)
+typedef struct {
+    size_t size;
+} BlockFooter;
+
+#define BLOCK_OVERHEAD (sizeof(BlockHeader) + sizeof(BlockFooter))
+
+// Header of a chunk mapped by a growable pool. The chunk's blocks follow
+// it directly and end in a zero-size, never-free header, so the physical
+// neighbours of a block stay inside its chunk.
+typedef struct PoolChunk {
+    struct PoolChunk* next;
+    struct PoolChunk* prev;
+    size_t size;        // Bytes mapped, header and fence included
+    size_t page_size;   // Granularity for madvise on this mapping
+    BlockFooter fence;  // Reads as CHUNK_FENCE to the first block
+} PoolChunk;
+
+// Pool statistics. The pool itself is single-writer (callers serialize
+// access to it), so the writer publishes every figure with plain relaxed
+// stores and any other thread can read them at any time without a lock.
+typedef struct {
+    _Atomic size_t allocs[NUM_SIZE_CLASSES];  // By block size class
+    _Atomic size_t frees[NUM_SIZE_CLASSES];
+    _Atomic size_t failed_allocs;
+    _Atomic size_t total_bytes;
+    _Atomic size_t used_bytes;
+    _Atomic size_t peak_used_bytes;
+    _Atomic size_t block_count;
+    _Atomic uint64_t class_bitmap;  // Copy of the segregated-fit bitmap
+} PoolStats;
+
+// One sampled allocation stack, guarded by a sequence counter that is odd
+// while the writer is updating the slot
+typedef struct {
+    atomic_uint sequence;
+    _Atomic size_t size;
+    _Atomic int depth;
+    _Atomic uintptr_t frames[SAMPLE_MAX_FRAMES];
+} StackSample;
+
+// Allocation stack sampler: records the call stack of every period-th
+// allocation into a ring of samples
+typedef struct {
+    size_t period;
+    size_t countdown;  // Writer only
+    atomic_size_t taken;
+    StackSample samples[SAMPLE_SLOTS];
+} PoolSampler;
+
+// Allocation strategy of a pool
+typedef enum {
+    POOL_FIRST_FIT,
+    POOL_SEGREGATED_FIT
+} PoolMode;
+
 // Memory pool structure
 typedef struct {
+    PoolMode mode;
     uint8_t* memory;
+    // First fit: one list of all free blocks
     BlockHeader* free_list;
+    // Segregated fit: one list per size class; bit c of class_bitmap is set
+    // while class_lists[c] is non-empty
+    BlockHeader* class_lists[NUM_SIZE_CLASSES];
+    uint64_t class_bitmap;
     size_t total_size;
     size_t used_size;
     size_t block_count;
+    // Growable pools: memory is NULL and blocks live in mmap'd chunks
+    size_t chunk_size;
+    bool huge_pages;
+    PoolChunk* chunks;
+    PoolChunk* spare_chunk;
+    size_t chunk_count;
+    // Instrumentation, readable from any thread
+    PoolStats stats;
+    _Atomic(PoolSampler*) sampler;
 } MemoryPool;
 
 // Function to align size to ALIGNMENT
@@ -31,8 +160,160 @@ size_t align_size(size_t size) {
     return (size + (ALIGNMENT - 1)) & ~(ALIGNMENT - 1);
 }
 
-// Function to create a new memory pool
-MemoryPool* create_memory_pool(size_t size) {
+// Function to write the boundary tag of a block after a size change
+void write_footer(BlockHeader* block) {
+    BlockFooter* footer = (BlockFooter*)((uint8_t*)block + sizeof(BlockHeader) + block->size);
+    footer->size = block->size;
+}
+
+// Function to get the block that follows block in memory, or NULL
+BlockHeader* next_physical(MemoryPool* pool, BlockHeader* block) {
+    uint8_t* next = (uint8_t*)block + BLOCK_OVERHEAD + block->size;
+    if (pool->memory) {
+        return next < pool->memory + pool->total_size ? (BlockHeader*)next : NULL;
+    }
+    // Chunk blocks end at a zero-size fence header
+    return ((BlockHeader*)next)->size ? (BlockHeader*)next : NULL;
+}
+
+// Function to get the block that precedes block in memory, or NULL
+BlockHeader* prev_physical(MemoryPool* pool, BlockHeader* block) {
+    if ((uint8_t*)block == pool->memory) {
+        return NULL;
+    }
+    BlockFooter* footer = (BlockFooter*)((uint8_t*)block - sizeof(BlockFooter));
+    if (footer->size == CHUNK_FENCE) {
+        return NULL;
+    }
+    return (BlockHeader*)((uint8_t*)block - footer->size - BLOCK_OVERHEAD);
+}
+
+// Function to get the largest size class whose minimum fits in size.
+// Blocks below MIN_BLOCK_SIZE, which only first-fit pools create, count
+// as class 0.
+size_t size_class_floor(size_t size) {
+    if (size < MIN_BLOCK_SIZE) {
+        return 0;
+    }
+    int msb = 63 - __builtin_clzll(size);
+    size_t size_class = 2 * (msb - 4) + ((size >> (msb - 1)) & 1);
+    return size_class < NUM_SIZE_CLASSES ? size_class : NUM_SIZE_CLASSES - 1;
+}
+
+// Function to get the smallest block size of a size class
+size_t size_class_min(size_t size_class) {
+    return (size_t)(2 + (size_class & 1)) << (size_class / 2 + 3);
+}
+
+// Function to get the smallest size class whose blocks all fit size
+size_t size_class_ceil(size_t size) {
+    size_t size_class = size_class_floor(size);
+    if (size_class_min(size_class) < size) {
+        size_class++;
+    }
+    return size_class;
+}
+
+// Function to push a free block onto the list of its size class
+void class_list_push(MemoryPool* pool, BlockHeader* block) {
+    size_t size_class = size_class_floor(block->size);
+    block->prev = NULL;
+    block->next = pool->class_lists[size_class];
+    if (block->next) {
+        block->next->prev = block;
+    }
+    pool->class_lists[size_class] = block;
+    pool->class_bitmap |= 1ULL << size_class;
+}
+
+// Function to unlink a free block from the list of its size class
+void class_list_remove(MemoryPool* pool, BlockHeader* block) {
+    size_t size_class = size_class_floor(block->size);
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        pool->class_lists[size_class] = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    if (!pool->class_lists[size_class]) {
+        pool->class_bitmap &= ~(1ULL << size_class);
+    }
+}
+
+// Function to unlink a free block from the first-fit list
+void free_list_remove(MemoryPool* pool, BlockHeader* block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        pool->free_list = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+}
+
+// Function to put a free block on the list its pool mode uses
+void attach_free_block(MemoryPool* pool, BlockHeader* block) {
+    if (pool->mode == POOL_SEGREGATED_FIT) {
+        class_list_push(pool, block);
+        return;
+    }
+    
+    block->next = pool->free_list;
+    block->prev = NULL;
+    if (pool->free_list) {
+        pool->free_list->prev = block;
+    }
+    pool->free_list = block;
+}
+
+// Function to take a free block off the list its pool mode uses
+void detach_free_block(MemoryPool* pool, BlockHeader* block) {
+    if (pool->mode == POOL_SEGREGATED_FIT) {
+        class_list_remove(pool, block);
+    } else {
+        free_list_remove(pool, block);
+    }
+}
+
+// Function to add to a statistic that only the pool's writer updates
+void stat_add(_Atomic size_t* stat, size_t amount) {
+    atomic_store_explicit(stat, atomic_load_explicit(stat, memory_order_relaxed) + amount,
+                          memory_order_relaxed);
+}
+
+// Function to publish the pool-wide figures after an operation
+void publish_pool_totals(MemoryPool* pool) {
+    PoolStats* stats = &pool->stats;
+    atomic_store_explicit(&stats->total_bytes, pool->total_size, memory_order_relaxed);
+    atomic_store_explicit(&stats->used_bytes, pool->used_size, memory_order_relaxed);
+    atomic_store_explicit(&stats->block_count, pool->block_count, memory_order_relaxed);
+    atomic_store_explicit(&stats->class_bitmap, pool->class_bitmap, memory_order_relaxed);
+    if (pool->used_size > atomic_load_explicit(&stats->peak_used_bytes, memory_order_relaxed)) {
+        atomic_store_explicit(&stats->peak_used_bytes, pool->used_size, memory_order_relaxed);
+    }
+}
+
+// Function to reset a pool's statistics and leave sampling off
+void init_pool_stats(MemoryPool* pool) {
+    PoolStats* stats = &pool->stats;
+    for (size_t c = 0; c < NUM_SIZE_CLASSES; c++) {
+        atomic_init(&stats->allocs[c], 0);
+        atomic_init(&stats->frees[c], 0);
+    }
+    atomic_init(&stats->failed_allocs, 0);
+    atomic_init(&stats->total_bytes, pool->total_size);
+    atomic_init(&stats->used_bytes, 0);
+    atomic_init(&stats->peak_used_bytes, 0);
+    atomic_init(&stats->block_count, 0);
+    atomic_init(&stats->class_bitmap, pool->class_bitmap);
+    atomic_init(&pool->sampler, NULL);
+}
+
+// Function to create a new memory pool with the given strategy
+MemoryPool* create_memory_pool_with_mode(size_t size, PoolMode mode) {
     MemoryPool* pool = (MemoryPool*)malloc(sizeof(MemoryPool));
     if (!pool) {
         printf("Failed to allocate pool structure\n");
@@ -51,36 +332,161 @@ MemoryPool* create_memory_pool(size_t size) {
     }
     
     // Initialize pool
+    pool->mode = mode;
+    memset(pool->class_lists, 0, sizeof(pool->class_lists));
+    pool->class_bitmap = 0;
     pool->total_size = size;
     pool->used_size = 0;
     pool->block_count = 0;
+    pool->chunk_size = 0;
+    pool->huge_pages = false;
+    pool->chunks = NULL;
+    pool->spare_chunk = NULL;
+    pool->chunk_count = 0;
     
     // Create initial free block
     BlockHeader* initial_block = (BlockHeader*)pool->memory;
-    initial_block->size = size - sizeof(BlockHeader);
+    initial_block->size = size - BLOCK_OVERHEAD;
     initial_block->is_free = true;
-    initial_block->next = NULL;
-    initial_block->prev = NULL;
+    write_footer(initial_block);
     
-    pool->free_list = initial_block;
+    pool->free_list = NULL;
+    attach_free_block(pool, initial_block);
+    init_pool_stats(pool);
     
     return pool;
 }
 
+// Function to create a new memory pool
+MemoryPool* create_memory_pool(size_t size) {
+    return create_memory_pool_with_mode(size, POOL_FIRST_FIT);
+}
+
+// Function to map a new chunk big enough for a request of size bytes and
+// put its single free block on the free lists. With huge_pages the chunk
+// is backed by explicit huge pages when the system has them reserved, and
+// otherwise asks for transparent huge pages.
+bool map_chunk(MemoryPool* pool, size_t size) {
+    // Room for class rounding of the request plus the chunk's own overhead
+    size_t bytes = sizeof(PoolChunk) + 2 * size + BLOCK_OVERHEAD + sizeof(BlockHeader);
+    if (bytes < pool->chunk_size) {
+        bytes = pool->chunk_size;
+    }
+    
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    void* memory = MAP_FAILED;
+    if (pool->huge_pages) {
+        size_t huge_bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+        memory = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            bytes = huge_bytes;
+            page_size = HUGE_PAGE_SIZE;
+        }
+    }
+    if (memory == MAP_FAILED) {
+        bytes = (bytes + page_size - 1) & ~(page_size - 1);
+        memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return false;
+        }
+        if (pool->huge_pages) {
+            madvise(memory, bytes, MADV_HUGEPAGE);
+        }
+    }
+    
+    PoolChunk* chunk = (PoolChunk*)memory;
+    chunk->size = bytes;
+    chunk->page_size = page_size;
+    chunk->fence.size = CHUNK_FENCE;
+    chunk->prev = NULL;
+    chunk->next = pool->chunks;
+    if (pool->chunks) {
+        pool->chunks->prev = chunk;
+    }
+    pool->chunks = chunk;
+    pool->chunk_count++;
+    pool->total_size += bytes;
+    
+    BlockHeader* fence = (BlockHeader*)((uint8_t*)chunk + bytes - sizeof(BlockHeader));
+    fence->size = 0;
+    fence->is_free = false;
+    
+    BlockHeader* block = (BlockHeader*)(chunk + 1);
+    block->size = (uint8_t*)fence - (uint8_t*)block - BLOCK_OVERHEAD;
+    block->is_free = true;
+    write_footer(block);
+    attach_free_block(pool, block);
+    publish_pool_totals(pool);
+    return true;
+}
+
+// Function to unlink a chunk from its pool and unmap it
+void unmap_chunk(MemoryPool* pool, PoolChunk* chunk) {
+    if (chunk->prev) {
+        chunk->prev->next = chunk->next;
+    } else {
+        pool->chunks = chunk->next;
+    }
+    if (chunk->next) {
+        chunk->next->prev = chunk->prev;
+    }
+    if (pool->spare_chunk == chunk) {
+        pool->spare_chunk = NULL;
+    }
+    pool->chunk_count--;
+    pool->total_size -= chunk->size;
+    munmap(chunk, chunk->size);
+}
+
+// Function to create a pool that starts with one chunk and maps more
+// chunks of at least chunk_size bytes whenever it runs out of space
+MemoryPool* create_growable_memory_pool(size_t chunk_size, PoolMode mode, bool huge_pages) {
+    MemoryPool* pool = (MemoryPool*)malloc(sizeof(MemoryPool));
+    if (!pool) {
+        printf("Failed to allocate pool structure\n");
+        return NULL;
+    }
+    
+    pool->mode = mode;
+    pool->memory = NULL;
+    pool->free_list = NULL;
+    memset(pool->class_lists, 0, sizeof(pool->class_lists));
+    pool->class_bitmap = 0;
+    pool->total_size = 0;
+    pool->used_size = 0;
+    pool->block_count = 0;
+    pool->chunk_size = chunk_size;
+    pool->huge_pages = huge_pages;
+    pool->chunks = NULL;
+    pool->spare_chunk = NULL;
+    pool->chunk_count = 0;
+    init_pool_stats(pool);
+    
+    if (!map_chunk(pool, 0)) {
+        printf("Failed to map pool chunk\n");
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
 // Function to split a block if it's too large
 void split_block(BlockHeader* block, size_t size) {
-    if (block->size <= size + sizeof(BlockHeader) + MIN_BLOCK_SIZE) {
+    if (block->size <= size + BLOCK_OVERHEAD + MIN_BLOCK_SIZE) {
         return;  // Block is too small to split
     }
     
     // Calculate new block size
-    size_t new_size = block->size - size - sizeof(BlockHeader);
+    size_t new_size = block->size - size - BLOCK_OVERHEAD;
     block->size = size;
+    write_footer(block);
     
     // Create new block
-    BlockHeader* new_block = (BlockHeader*)((uint8_t*)block + sizeof(BlockHeader) + size);
+    BlockHeader* new_block = (BlockHeader*)((uint8_t*)block + BLOCK_OVERHEAD + size);
     new_block->size = new_size;
     new_block->is_free = true;
+    write_footer(new_block);
     new_block->next = block->next;
     new_block->prev = block;
     
@@ -90,15 +496,48 @@ void split_block(BlockHeader* block, size_t size) {
     block->next = new_block;
 }
 
-// Function to allocate memory from the pool
-void* pool_alloc(MemoryPool* pool, size_t size) {
-    if (!pool || size == 0) {
+// Function to allocate from the size class lists in O(1): the lowest set
+// bitmap bit at or above the request's class names a list whose head is
+// guaranteed to fit, and the unused tail goes back to its own class
+void* segregated_alloc(MemoryPool* pool, size_t size) {
+    if (size < MIN_BLOCK_SIZE) {
+        size = MIN_BLOCK_SIZE;
+    }
+    
+    size_t size_class = size_class_ceil(size);
+    if (size_class >= NUM_SIZE_CLASSES) {
         return NULL;
     }
+    uint64_t candidates = pool->class_bitmap & (~0ULL << size_class);
+    if (!candidates) {
+        return NULL;  // No suitable block found
+    }
     
-    // Align requested size
-    size = align_size(size);
+    BlockHeader* block = pool->class_lists[__builtin_ctzll(candidates)];
+    class_list_remove(pool, block);
     
+    // Split off the tail if it can hold a block of its own
+    if (block->size > size + BLOCK_OVERHEAD + MIN_BLOCK_SIZE) {
+        BlockHeader* rest = (BlockHeader*)((uint8_t*)block + BLOCK_OVERHEAD + size);
+        rest->size = block->size - size - BLOCK_OVERHEAD;
+        rest->is_free = true;
+        write_footer(rest);
+        block->size = size;
+        write_footer(block);
+        class_list_push(pool, rest);
+    }
+    
+    block->is_free = false;
+    block->next = NULL;
+    block->prev = NULL;
+    pool->used_size += block->size + BLOCK_OVERHEAD;
+    pool->block_count++;
+    
+    return (void*)((uint8_t*)block + sizeof(BlockHeader));
+}
+
+// Function to allocate from the first-fit list
+void* first_fit_alloc(MemoryPool* pool, size_t size) {
     // Find suitable free block
     BlockHeader* current = pool->free_list;
     while (current) {
@@ -108,18 +547,11 @@ void* pool_alloc(MemoryPool* pool, size_t size) {
             
             // Mark block as used
             current->is_free = false;
-            pool->used_size += current->size + sizeof(BlockHeader);
+            pool->used_size += current->size + BLOCK_OVERHEAD;
             pool->block_count++;
             
             // Remove from free list
-            if (current->prev) {
-                current->prev->next = current->next;
-            } else {
-                pool->free_list = current->next;
-            }
-            if (current->next) {
-                current->next->prev = current->prev;
-            }
+            free_list_remove(pool, current);
             
             return (void*)((uint8_t*)current + sizeof(BlockHeader));
         }
@@ -129,27 +561,150 @@ void* pool_alloc(MemoryPool* pool, size_t size) {
     return NULL;  // No suitable block found
 }
 
-// Function to merge adjacent free blocks
-void merge_blocks(BlockHeader* block) {
-    if (!block) return;
+// Function to record the call stack of an allocation into the next
+// sample slot. Kept out of line so the only frame skipped is its own; the
+// stack starts inside pool_alloc.
+__attribute__((noinline)) void record_sample(PoolSampler* sampler, size_t size) {
+    void* frames[SAMPLE_MAX_FRAMES + 1];
+    int depth = backtrace(frames, SAMPLE_MAX_FRAMES + 1) - 1;
+    if (depth < 0) {
+        depth = 0;
+    }
     
-    // Merge with next block if it's free
-    if (block->next && block->next->is_free) {
-        block->size += block->next->size + sizeof(BlockHeader);
-        block->next = block->next->next;
-        if (block->next) {
-            block->next->prev = block;
+    size_t taken = atomic_load_explicit(&sampler->taken, memory_order_relaxed);
+    StackSample* sample = &sampler->samples[taken % SAMPLE_SLOTS];
+    unsigned sequence = atomic_load_explicit(&sample->sequence, memory_order_relaxed);
+    atomic_store_explicit(&sample->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    
+    atomic_store_explicit(&sample->size, size, memory_order_relaxed);
+    atomic_store_explicit(&sample->depth, depth, memory_order_relaxed);
+    for (int i = 0; i < depth; i++) {
+        atomic_store_explicit(&sample->frames[i], (uintptr_t)frames[i + 1], memory_order_relaxed);
+    }
+    
+    atomic_store_explicit(&sample->sequence, sequence + 2, memory_order_release);
+    atomic_store_explicit(&sampler->taken, taken + 1, memory_order_relaxed);
+}
+
+// Function to start sampling the call stack of every period-th
+// allocation; a period of 0 stops sampling. Called by the pool's writer.
+bool pool_set_sampling(MemoryPool* pool, size_t period) {
+    PoolSampler* sampler = atomic_load_explicit(&pool->sampler, memory_order_relaxed);
+    if (period == 0) {
+        // Kept allocated so concurrent exporters never see it freed
+        if (sampler) {
+            sampler->period = 0;
+        }
+        return true;
+    }
+    
+    if (!sampler) {
+        sampler = (PoolSampler*)calloc(1, sizeof(PoolSampler));
+        if (!sampler) {
+            printf("Failed to allocate sampler\n");
+            return false;
         }
+        atomic_store_explicit(&pool->sampler, sampler, memory_order_release);
+    }
+    sampler->period = period;
+    sampler->countdown = period;
+    return true;
+}
+
+// Function to count an allocation (or failure) of a request of size bytes
+void record_alloc(MemoryPool* pool, void* ptr, size_t size) {
+    if (!ptr) {
+        stat_add(&pool->stats.failed_allocs, 1);
+        return;
+    }
+    
+    BlockHeader* block = (BlockHeader*)((uint8_t*)ptr - sizeof(BlockHeader));
+    stat_add(&pool->stats.allocs[size_class_floor(block->size)], 1);
+    publish_pool_totals(pool);
+    
+    PoolSampler* sampler = atomic_load_explicit(&pool->sampler, memory_order_relaxed);
+    if (sampler && sampler->period && --sampler->countdown == 0) {
+        sampler->countdown = sampler->period;
+        record_sample(sampler, size);
+    }
+}
+
+// Function to allocate memory from the pool
+void* pool_alloc(MemoryPool* pool, size_t size) {
+    if (!pool || size == 0) {
+        return NULL;
+    }
+    
+    // Align requested size
+    size = align_size(size);
+    
+    void* ptr = pool->mode == POOL_SEGREGATED_FIT ? segregated_alloc(pool, size) : first_fit_alloc(pool, size);
+    
+    // A growable pool maps a new chunk and retries once
+    if (!ptr && pool->chunk_size && map_chunk(pool, size)) {
+        ptr = pool->mode == POOL_SEGREGATED_FIT ? segregated_alloc(pool, size) : first_fit_alloc(pool, size);
+    }
+    record_alloc(pool, ptr, size);
+    return ptr;
+}
+
+// Function to merge a free block (not on any list yet) with the free
+// blocks physically next to it. The next block is found from the size in
+// the header, the previous one from its footer, so this is O(1) and finds
+// every adjacent free block regardless of free-list order. Returns the
+// merged block.
+BlockHeader* merge_blocks(MemoryPool* pool, BlockHeader* block) {
+    // Merge with next block if it's free
+    BlockHeader* next = next_physical(pool, block);
+    if (next && next->is_free) {
+        detach_free_block(pool, next);
+        block->size += next->size + BLOCK_OVERHEAD;
     }
     
     // Merge with previous block if it's free
-    if (block->prev && block->prev->is_free) {
-        block->prev->size += block->size + sizeof(BlockHeader);
-        block->prev->next = block->next;
-        if (block->next) {
-            block->next->prev = block->prev;
+    BlockHeader* prev = prev_physical(pool, block);
+    if (prev && prev->is_free) {
+        detach_free_block(pool, prev);
+        prev->size += block->size + BLOCK_OVERHEAD;
+        block = prev;
+    }
+    
+    write_footer(block);
+    return block;
+}
+
+// Function to hand the memory of a chunk that became empty back to the
+// OS; block is the merged free block spanning the whole chunk. One empty
+// chunk is kept mapped as a spare with its pages dropped through
+// MADV_DONTNEED, so a pool hovering at a chunk boundary does not map and
+// unmap on every cycle; other empty chunks are unmapped. Returns true if
+// block went away with its chunk.
+bool release_empty_chunk(MemoryPool* pool, BlockHeader* block) {
+    PoolChunk* chunk = (PoolChunk*)((uint8_t*)block - sizeof(PoolChunk));
+    
+    // The spare only counts while it is still empty
+    PoolChunk* spare = pool->spare_chunk;
+    if (spare && spare != chunk) {
+        BlockHeader* first = (BlockHeader*)(spare + 1);
+        if (!first->is_free || next_physical(pool, first)) {
+            spare = NULL;
         }
     }
+    
+    if (spare && spare != chunk) {
+        unmap_chunk(pool, chunk);
+        return true;
+    }
+    
+    // Drop every page between the block header and its footer
+    uintptr_t start = ((uintptr_t)(block + 1) + chunk->page_size - 1) & ~(uintptr_t)(chunk->page_size - 1);
+    uintptr_t end = ((uintptr_t)block + sizeof(BlockHeader) + block->size) & ~(uintptr_t)(chunk->page_size - 1);
+    if (start < end) {
+        madvise((void*)start, end - start, MADV_DONTNEED);
+    }
+    pool->spare_chunk = chunk;
+    return false;
 }
 
 // Function to free memory back to the pool
@@ -163,19 +718,129 @@ void pool_free(MemoryPool* pool, void* ptr) {
     
     // Mark block as free
     block->is_free = true;
-    pool->used_size -= block->size + sizeof(BlockHeader);
+    pool->used_size -= block->size + BLOCK_OVERHEAD;
     pool->block_count--;
+    stat_add(&pool->stats.frees[size_class_floor(block->size)], 1);
     
-    // Add to free list
-    block->next = pool->free_list;
-    block->prev = NULL;
-    if (pool->free_list) {
-        pool->free_list->prev = block;
+    // Merge adjacent free blocks, then add to free list unless that
+    // emptied a chunk that is handed back to the OS
+    block = merge_blocks(pool, block);
+    if (!pool->chunk_size || prev_physical(pool, block) || next_physical(pool, block) ||
+        !release_empty_chunk(pool, block)) {
+        attach_free_block(pool, block);
     }
-    pool->free_list = block;
+    publish_pool_totals(pool);
+}
+
+// Function to add up the free blocks physically following first
+void tally_free_blocks(MemoryPool* pool, BlockHeader* first, size_t* total_free, size_t* largest_free) {
+    for (BlockHeader* block = first; block; block = next_physical(pool, block)) {
+        if (block->is_free) {
+            *total_free += block->size;
+            if (block->size > *largest_free) {
+                *largest_free = block->size;
+            }
+        }
+    }
+}
+
+// Function to measure external fragmentation by walking every block:
+// the share of free memory that lies outside the largest free block
+double pool_fragmentation(MemoryPool* pool, size_t* largest_free) {
+    size_t total_free = 0;
+    *largest_free = 0;
+    
+    if (pool->memory) {
+        tally_free_blocks(pool, (BlockHeader*)pool->memory, &total_free, largest_free);
+    }
+    for (PoolChunk* chunk = pool->chunks; chunk; chunk = chunk->next) {
+        tally_free_blocks(pool, (BlockHeader*)(chunk + 1), &total_free, largest_free);
+    }
+    return total_free ? 100.0 * (1.0 - (double)*largest_free / total_free) : 0.0;
+}
+
+// Function to write a pool's statistics as JSON. Only the published
+// statistics are read, so this may run on any thread while the pool is in
+// use; figures from different fields can be a few operations apart.
+//
+// The fragmentation ratio is estimated from the size classes that have
+// free blocks: the largest free block is at least the minimum size of the
+// highest such class, so the share of free memory outside it is at most
+// the reported bound. First-fit pools keep no classes and report null.
+void pool_stats_json(MemoryPool* pool, FILE* out) {
+    PoolStats* stats = &pool->stats;
+    size_t total = atomic_load_explicit(&stats->total_bytes, memory_order_relaxed);
+    size_t used = atomic_load_explicit(&stats->used_bytes, memory_order_relaxed);
+    uint64_t bitmap = atomic_load_explicit(&stats->class_bitmap, memory_order_relaxed);
+    size_t free_bytes = total > used ? total - used : 0;
+    
+    fprintf(out, "{\"mode\":\"%s\",\"total_bytes\":%zu,\"used_bytes\":%zu,\"peak_used_bytes\":%zu,",
+            pool->mode == POOL_SEGREGATED_FIT ? "segregated-fit" : "first-fit", total, used,
+            atomic_load_explicit(&stats->peak_used_bytes, memory_order_relaxed));
+    fprintf(out, "\"block_count\":%zu,\"failed_allocs\":%zu,",
+            atomic_load_explicit(&stats->block_count, memory_order_relaxed),
+            atomic_load_explicit(&stats->failed_allocs, memory_order_relaxed));
+    
+    if (pool->mode != POOL_SEGREGATED_FIT) {
+        fprintf(out, "\"fragmentation\":null,");
+    } else {
+        size_t largest = bitmap ? size_class_min(63 - __builtin_clzll(bitmap)) : 0;
+        if (largest > free_bytes) {
+            largest = free_bytes;
+        }
+        fprintf(out, "\"fragmentation\":{\"free_bytes\":%zu,\"largest_free_at_least\":%zu,\"ratio_at_most\":%.4f},",
+                free_bytes, largest, free_bytes ? 1.0 - (double)largest / free_bytes : 0.0);
+    }
+    
+    // Histogram of the classes that saw any traffic
+    fprintf(out, "\"size_classes\":[");
+    bool first = true;
+    for (size_t c = 0; c < NUM_SIZE_CLASSES; c++) {
+        size_t allocs = atomic_load_explicit(&stats->allocs[c], memory_order_relaxed);
+        size_t frees = atomic_load_explicit(&stats->frees[c], memory_order_relaxed);
+        if (allocs || frees) {
+            fprintf(out, "%s{\"class\":%zu,\"min_size\":%zu,\"allocs\":%zu,\"frees\":%zu}",
+                    first ? "" : ",", c, size_class_min(c), allocs, frees);
+            first = false;
+        }
+    }
+    fprintf(out, "],");
     
-    // Merge adjacent free blocks
-    merge_blocks(block);
+    // Sampled stacks; a slot the writer is updating right now is skipped
+    PoolSampler* sampler = atomic_load_explicit(&pool->sampler, memory_order_acquire);
+    if (!sampler) {
+        fprintf(out, "\"samples\":null}\n");
+        return;
+    }
+    fprintf(out, "\"samples_taken\":%zu,\"samples\":[",
+            atomic_load_explicit(&sampler->taken, memory_order_relaxed));
+    first = true;
+    for (size_t i = 0; i < SAMPLE_SLOTS; i++) {
+        StackSample* sample = &sampler->samples[i];
+        unsigned sequence = atomic_load_explicit(&sample->sequence, memory_order_acquire);
+        if (sequence == 0 || sequence & 1) {
+            continue;
+        }
+        
+        size_t size = atomic_load_explicit(&sample->size, memory_order_relaxed);
+        int depth = atomic_load_explicit(&sample->depth, memory_order_relaxed);
+        uintptr_t frames[SAMPLE_MAX_FRAMES];
+        for (int f = 0; f < depth && f < SAMPLE_MAX_FRAMES; f++) {
+            frames[f] = atomic_load_explicit(&sample->frames[f], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&sample->sequence, memory_order_relaxed) != sequence) {
+            continue;
+        }
+        
+        fprintf(out, "%s{\"size\":%zu,\"stack\":[", first ? "" : ",", size);
+        for (int f = 0; f < depth && f < SAMPLE_MAX_FRAMES; f++) {
+            fprintf(out, "%s\"%#lx\"", f ? "," : "", (unsigned long)frames[f]);
+        }
+        fprintf(out, "]}");
+        first = false;
+    }
+    fprintf(out, "]}\n");
 }
 
 // Function to print pool statistics
@@ -185,6 +850,9 @@ void print_pool_stats(MemoryPool* pool) {
     printf("Used Size: %zu bytes\n", pool->used_size);
     printf("Free Size: %zu bytes\n", pool->total_size - pool->used_size);
     printf("Block Count: %zu\n", pool->block_count);
+    if (pool->chunk_size) {
+        printf("Chunks: %zu\n", pool->chunk_count);
+    }
     
     printf("\nFree Blocks:\n");
     BlockHeader* current = pool->free_list;
@@ -192,17 +860,735 @@ void print_pool_stats(MemoryPool* pool) {
         printf("Block at %p: %zu bytes\n", (void*)current, current->size);
         current = current->next;
     }
+    for (size_t c = 0; c < NUM_SIZE_CLASSES; c++) {
+        for (current = pool->class_lists[c]; current; current = current->next) {
+            printf("Block at %p: %zu bytes (class %zu)\n", (void*)current, current->size, c);
+        }
+    }
 }
 
 // Function to free the memory pool
 void free_memory_pool(MemoryPool* pool) {
     if (pool) {
+        while (pool->chunks) {
+            unmap_chunk(pool, pool->chunks);
+        }
+        free(atomic_load(&pool->sampler));
         free(pool->memory);
         free(pool);
     }
 }
 
-int main() {
+typedef struct ThreadCache ThreadCache;
+
+// Shared pool behind the thread caches: a segregated-fit pool guarded by
+// one mutex, plus the list of every cache attached to it
+typedef struct {
+    MemoryPool* pool;
+    pthread_mutex_t lock;
+    ThreadCache* caches;
+} SharedPool;
+
+// Magazine: a stack of allocated-but-unused payloads of one size class
+typedef struct {
+    size_t count;
+    void* items[MAGAZINE_CAPACITY];
+} Magazine;
+
+// Per-thread cache. A block handed out through a cache keeps the owning
+// cache in its header's prev field, which is unused while a block is
+// allocated. A thread freeing a block it does not own pushes it onto the
+// owner's lock-free return queue, linked through the header's next field;
+// only the owner takes from the queue, and always the whole list at once.
+struct ThreadCache {
+    _Atomic(BlockHeader*) return_queue;
+    SharedPool* shared __attribute__((aligned(CACHE_LINE)));
+    ThreadCache* next;
+    Magazine magazines[CACHED_CLASSES];
+} __attribute__((aligned(CACHE_LINE)));
+
+// Function to create a shared pool for thread caches
+SharedPool* create_shared_pool(size_t size) {
+    SharedPool* shared = (SharedPool*)malloc(sizeof(SharedPool));
+    if (!shared) {
+        printf("Failed to allocate shared pool\n");
+        return NULL;
+    }
+    
+    shared->pool = create_memory_pool_with_mode(size, POOL_SEGREGATED_FIT);
+    if (!shared->pool) {
+        free(shared);
+        return NULL;
+    }
+    pthread_mutex_init(&shared->lock, NULL);
+    shared->caches = NULL;
+    return shared;
+}
+
+// Function to attach a cache for the calling thread to a shared pool
+ThreadCache* thread_cache_attach(SharedPool* shared) {
+    ThreadCache* cache = (ThreadCache*)aligned_alloc(CACHE_LINE, sizeof(ThreadCache));
+    if (!cache) {
+        printf("Failed to allocate thread cache\n");
+        return NULL;
+    }
+    
+    atomic_init(&cache->return_queue, NULL);
+    cache->shared = shared;
+    for (size_t c = 0; c < CACHED_CLASSES; c++) {
+        cache->magazines[c].count = 0;
+    }
+    
+    pthread_mutex_lock(&shared->lock);
+    cache->next = shared->caches;
+    shared->caches = cache;
+    pthread_mutex_unlock(&shared->lock);
+    return cache;
+}
+
+// Function to free one block straight into the shared pool
+void shared_free(SharedPool* shared, void* ptr) {
+    pthread_mutex_lock(&shared->lock);
+    pool_free(shared->pool, ptr);
+    pthread_mutex_unlock(&shared->lock);
+}
+
+// Function to fill an empty magazine with MAGAZINE_BATCH blocks of its
+// size class under a single lock acquisition
+void magazine_refill(ThreadCache* cache, size_t size_class) {
+    Magazine* magazine = &cache->magazines[size_class];
+    size_t size = size_class_min(size_class);
+    
+    pthread_mutex_lock(&cache->shared->lock);
+    while (magazine->count < MAGAZINE_BATCH) {
+        void* ptr = pool_alloc(cache->shared->pool, size);
+        if (!ptr) {
+            break;
+        }
+        ((BlockHeader*)((uint8_t*)ptr - sizeof(BlockHeader)))->prev = (BlockHeader*)cache;
+        magazine->items[magazine->count++] = ptr;
+    }
+    pthread_mutex_unlock(&cache->shared->lock);
+}
+
+// Function to put a block owned by this cache into the magazine of its
+// size class. A full magazine first returns its oldest MAGAZINE_BATCH
+// blocks to the shared pool under a single lock acquisition.
+void magazine_push(ThreadCache* cache, BlockHeader* block) {
+    void* ptr = (uint8_t*)block + sizeof(BlockHeader);
+    // Blocks are never shrunk, so the class is at least the one they were
+    // allocated for and may be above the cached range
+    size_t size_class = size_class_floor(block->size);
+    if (size_class >= CACHED_CLASSES) {
+        shared_free(cache->shared, ptr);
+        return;
+    }
+    
+    Magazine* magazine = &cache->magazines[size_class];
+    if (magazine->count == MAGAZINE_CAPACITY) {
+        pthread_mutex_lock(&cache->shared->lock);
+        for (size_t i = 0; i < MAGAZINE_BATCH; i++) {
+            pool_free(cache->shared->pool, magazine->items[i]);
+        }
+        pthread_mutex_unlock(&cache->shared->lock);
+        memmove(magazine->items, magazine->items + MAGAZINE_BATCH,
+                (MAGAZINE_CAPACITY - MAGAZINE_BATCH) * sizeof(void*));
+        magazine->count -= MAGAZINE_BATCH;
+    }
+    magazine->items[magazine->count++] = ptr;
+}
+
+// Function to take back every block other threads freed into this cache,
+// leaving new_head (NULL, or RETURN_QUEUE_CLOSED on detach) in the queue
+void drain_return_queue(ThreadCache* cache, BlockHeader* new_head) {
+    BlockHeader* block = atomic_exchange_explicit(&cache->return_queue, new_head, memory_order_acquire);
+    while (block) {
+        BlockHeader* next = block->next;
+        magazine_push(cache, block);
+        block = next;
+    }
+}
+
+// Function to allocate through a thread cache. Small requests pop from
+// the magazine of their size class and touch the shared pool only to
+// refill an empty magazine; larger ones go to the shared pool directly.
+void* cache_alloc(ThreadCache* cache, size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+    
+    if (size > CACHE_MAX_REQUEST) {
+        pthread_mutex_lock(&cache->shared->lock);
+        void* ptr = pool_alloc(cache->shared->pool, size);
+        pthread_mutex_unlock(&cache->shared->lock);
+        if (ptr) {
+            ((BlockHeader*)((uint8_t*)ptr - sizeof(BlockHeader)))->prev = NULL;  // No owner
+        }
+        return ptr;
+    }
+    
+    size_t size_class = size_class_ceil(size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : size);
+    Magazine* magazine = &cache->magazines[size_class];
+    if (magazine->count == 0) {
+        // Blocks freed by other threads are cheaper than the shared pool
+        drain_return_queue(cache, NULL);
+        if (magazine->count == 0) {
+            magazine_refill(cache, size_class);
+        }
+        if (magazine->count == 0) {
+            return NULL;
+        }
+    }
+    return magazine->items[--magazine->count];
+}
+
+// Function to free a block through the calling thread's cache, from
+// whichever thread's cache it was allocated
+void cache_free(ThreadCache* cache, void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    
+    BlockHeader* block = (BlockHeader*)((uint8_t*)ptr - sizeof(BlockHeader));
+    ThreadCache* owner = (ThreadCache*)block->prev;
+    if (owner == cache) {
+        magazine_push(cache, block);
+        return;
+    }
+    
+    if (owner) {
+        // Treiber push; safe without ABA tags because the owner only ever
+        // detaches the whole list. Closing the queue is part of the same
+        // CAS sequence, so a block is either drained by the owner or
+        // freed here, never stranded.
+        BlockHeader* head = atomic_load_explicit(&owner->return_queue, memory_order_relaxed);
+        do {
+            if (head == RETURN_QUEUE_CLOSED) {
+                shared_free(cache->shared, ptr);
+                return;
+            }
+            block->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&owner->return_queue, &head, block,
+                                                        memory_order_release, memory_order_relaxed));
+        return;
+    }
+    
+    // Uncached block
+    shared_free(cache->shared, ptr);
+}
+
+// Function to detach a thread's cache: its magazines and return queue go
+// back to the shared pool, and its blocks freed later by other threads go
+// straight to the shared pool. The cache must not be used afterwards, but
+// stays allocated until the shared pool is freed, since other threads
+// still read its closed return queue when freeing its blocks.
+void thread_cache_detach(ThreadCache* cache) {
+    drain_return_queue(cache, RETURN_QUEUE_CLOSED);
+    
+    pthread_mutex_lock(&cache->shared->lock);
+    for (size_t c = 0; c < CACHED_CLASSES; c++) {
+        Magazine* magazine = &cache->magazines[c];
+        for (size_t i = 0; i < magazine->count; i++) {
+            pool_free(cache->shared->pool, magazine->items[i]);
+        }
+        magazine->count = 0;
+    }
+    pthread_mutex_unlock(&cache->shared->lock);
+}
+
+// Function to free a shared pool and every cache attached to it
+void free_shared_pool(SharedPool* shared) {
+    if (!shared) {
+        return;
+    }
+    
+    ThreadCache* cache = shared->caches;
+    while (cache) {
+        ThreadCache* next = cache->next;
+        free(cache);
+        cache = next;
+    }
+    pthread_mutex_destroy(&shared->lock);
+    free_memory_pool(shared->pool);
+    free(shared);
+}
+
+// Function to read a monotonic clock in seconds
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Function to advance a xorshift64 generator
+uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Function to run random free/alloc churn over a fixed number of live
+// slots and report the cost per operation
+void run_churn(PoolMode mode, size_t ops, size_t live) {
+    MemoryPool* pool = create_memory_pool_with_mode(CHURN_POOL_SIZE, mode);
+    void** slots = (void**)calloc(live, sizeof(void*));
+    if (!pool || !slots) {
+        printf("Failed to set up churn benchmark\n");
+        exit(1);
+    }
+    
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    size_t failures = 0;
+    double start = now_seconds();
+    
+    for (size_t i = 0; i < ops; i++) {
+        uint64_t r = next_random(&rng);
+        size_t slot = r % live;
+        // Mostly small requests with an occasional large one
+        size_t size = (r >> 32) % 8 == 0 ? 1 + (r >> 40) % CHURN_MAX_REQUEST : 1 + (r >> 40) % 64;
+        
+        pool_free(pool, slots[slot]);
+        slots[slot] = pool_alloc(pool, size);
+        if (!slots[slot]) {
+            failures++;
+        }
+    }
+    
+    double elapsed = now_seconds() - start;
+    printf("%-16s %10zu %8zu %12.1f %10zu %12zu\n",
+           mode == POOL_SEGREGATED_FIT ? "segregated-fit" : "first-fit", ops, live,
+           elapsed * 1e9 / ops, failures, pool->block_count);
+    
+    free(slots);
+    free_memory_pool(pool);
+}
+
+// Function to report largest free block and external fragmentation at
+// regular points of a long churn run
+void run_fragmentation(PoolMode mode, size_t ops, size_t live) {
+    MemoryPool* pool = create_memory_pool_with_mode(CHURN_POOL_SIZE, mode);
+    void** slots = (void**)calloc(live, sizeof(void*));
+    if (!pool || !slots) {
+        printf("Failed to set up fragmentation benchmark\n");
+        exit(1);
+    }
+    
+    printf("\n%s\n%12s %16s %14s %10s\n",
+           mode == POOL_SEGREGATED_FIT ? "segregated-fit" : "first-fit",
+           "ops", "largest free", "external frag", "failures");
+    
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    size_t failures = 0;
+    for (size_t i = 1; i <= ops; i++) {
+        uint64_t r = next_random(&rng);
+        size_t slot = r % live;
+        size_t size = (r >> 32) % 8 == 0 ? 1 + (r >> 40) % CHURN_MAX_REQUEST : 1 + (r >> 40) % 64;
+        
+        pool_free(pool, slots[slot]);
+        slots[slot] = pool_alloc(pool, size);
+        if (!slots[slot]) {
+            failures++;
+        }
+        
+        if (i % (ops / FRAG_SAMPLES ? ops / FRAG_SAMPLES : 1) == 0) {
+            size_t largest;
+            double fragmentation = pool_fragmentation(pool, &largest);
+            printf("%12zu %16zu %13.2f%% %10zu\n", i, largest, fragmentation, failures);
+        }
+    }
+    
+    free(slots);
+    free_memory_pool(pool);
+}
+
+// Function to track fragmentation over time for both strategies
+int run_fragmentation_benchmark(int argc, char** argv) {
+    size_t ops = argc > 0 ? strtoull(argv[0], NULL, 10) : CHURN_DEFAULT_OPS;
+    size_t live = argc > 1 ? strtoull(argv[1], NULL, 10) : CHURN_DEFAULT_LIVE;
+    if (ops == 0 || live == 0) {
+        printf("Usage: frag [ops] [live blocks]\n");
+        return 1;
+    }
+    
+    run_fragmentation(POOL_FIRST_FIT, ops, live);
+    run_fragmentation(POOL_SEGREGATED_FIT, ops, live);
+    return 0;
+}
+
+// Function to compare first-fit and segregated-fit allocation under churn
+int run_churn_benchmark(int argc, char** argv) {
+    size_t ops = argc > 0 ? strtoull(argv[0], NULL, 10) : CHURN_DEFAULT_OPS;
+    size_t live = argc > 1 ? strtoull(argv[1], NULL, 10) : CHURN_DEFAULT_LIVE;
+    if (ops == 0 || live == 0) {
+        printf("Usage: bench [ops] [live blocks]\n");
+        return 1;
+    }
+    
+    printf("%-16s %10s %8s %12s %10s %12s\n",
+           "mode", "ops", "live", "ns/op", "failures", "live blocks");
+    run_churn(POOL_FIRST_FIT, ops, live);
+    run_churn(POOL_SEGREGATED_FIT, ops, live);
+    return 0;
+}
+
+// Shared state between the stats benchmark and its exporter thread
+typedef struct {
+    MemoryPool* pool;
+    atomic_bool done;
+    size_t exports;
+} StatsExporter;
+
+// Function to export a pool's statistics every millisecond until done
+void* stats_exporter_thread(void* arg) {
+    StatsExporter* exporter = (StatsExporter*)arg;
+    FILE* out = fopen("/dev/null", "w");
+    if (!out) {
+        return NULL;
+    }
+    
+    struct timespec interval = {0, STATS_EXPORT_INTERVAL_NS};
+    while (!atomic_load(&exporter->done)) {
+        pool_stats_json(exporter->pool, out);
+        exporter->exports++;
+        nanosleep(&interval, NULL);
+    }
+    fclose(out);
+    return NULL;
+}
+
+// Function to time churn at one sampling period while another thread
+// keeps exporting the statistics
+double run_stats_churn(MemoryPool* pool, size_t ops, size_t live, size_t period, size_t* exports) {
+    void** slots = (void**)calloc(live, sizeof(void*));
+    if (!slots || !pool_set_sampling(pool, period)) {
+        printf("Failed to set up stats benchmark\n");
+        exit(1);
+    }
+    
+    StatsExporter exporter = {pool, false, 0};
+    pthread_t thread;
+    pthread_create(&thread, NULL, stats_exporter_thread, &exporter);
+    
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    double start = now_seconds();
+    for (size_t i = 0; i < ops; i++) {
+        uint64_t r = next_random(&rng);
+        size_t slot = r % live;
+        size_t size = (r >> 32) % 8 == 0 ? 1 + (r >> 40) % CHURN_MAX_REQUEST : 1 + (r >> 40) % 64;
+        
+        pool_free(pool, slots[slot]);
+        slots[slot] = pool_alloc(pool, size);
+    }
+    double elapsed = now_seconds() - start;
+    
+    atomic_store(&exporter.done, true);
+    pthread_join(thread, NULL);
+    *exports = exporter.exports;
+    
+    for (size_t i = 0; i < live; i++) {
+        pool_free(pool, slots[i]);
+    }
+    free(slots);
+    return elapsed * 1e9 / ops;
+}
+
+// Function to measure the cost of stack sampling under churn with a
+// concurrent exporter, then print the final statistics as JSON
+int run_stats_benchmark(int argc, char** argv) {
+    size_t ops = argc > 0 ? strtoull(argv[0], NULL, 10) : CHURN_DEFAULT_OPS;
+    size_t period = argc > 1 ? strtoull(argv[1], NULL, 10) : STATS_DEFAULT_PERIOD;
+    if (ops == 0 || period == 0) {
+        printf("Usage: stats [ops] [sample period]\n");
+        return 1;
+    }
+    
+    MemoryPool* pool = create_memory_pool_with_mode(CHURN_POOL_SIZE, POOL_SEGREGATED_FIT);
+    if (!pool) {
+        exit(1);
+    }
+    
+    size_t exports;
+    printf("%-16s %12s %10s\n", "sampling", "ns/op", "exports");
+    double ns = run_stats_churn(pool, ops, CHURN_DEFAULT_LIVE, 0, &exports);
+    printf("%-16s %12.1f %10zu\n", "off", ns, exports);
+    ns = run_stats_churn(pool, ops, CHURN_DEFAULT_LIVE, period, &exports);
+    printf("1 in %-11zu %12.1f %10zu\n\n", period, ns, exports);
+    
+    pool_stats_json(pool, stdout);
+    free_memory_pool(pool);
+    
+    // A first-fit pool makes blocks below MIN_BLOCK_SIZE, which must land
+    // in class 0 of the histogram
+    MemoryPool* small = create_memory_pool(POOL_SIZE);
+    char* json = NULL;
+    size_t json_size = 0;
+    FILE* out = open_memstream(&json, &json_size);
+    if (!small || !out) {
+        exit(1);
+    }
+    pool_free(small, pool_alloc(small, 8));
+    pool_stats_json(small, out);
+    fclose(out);
+    printf("\n%-16s %10s\n", "8-byte histogram",
+           strstr(json, "{\"class\":0,\"min_size\":16,\"allocs\":1,\"frees\":1}") ? "ok" : "MISMATCH");
+    free(json);
+    free_memory_pool(small);
+    return 0;
+}
+
+// Function to read the resident set size of this process in bytes
+size_t resident_bytes() {
+    FILE* file = fopen("/proc/self/statm", "r");
+    unsigned long pages = 0, resident = 0;
+    if (file) {
+        if (fscanf(file, "%lu %lu", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(file);
+    }
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// Function to print mapped and resident memory after one growth phase
+void print_grow_phase(const char* phase, MemoryPool* pool) {
+    printf("%-22s %10zu %8zu %12.1f %12.1f\n", phase, pool->block_count, pool->chunk_count,
+           pool->total_size / 1048576.0, resident_bytes() / 1048576.0);
+}
+
+// Function to grow a pool to a peak, free most of it, then the rest, and
+// show mapped and resident memory following the live set
+int run_grow_benchmark(int argc, char** argv) {
+    size_t blocks = argc > 0 ? strtoull(argv[0], NULL, 10) : GROW_DEFAULT_BLOCKS;
+    size_t chunk_size = argc > 1 ? strtoull(argv[1], NULL, 10) * 1024 : DEFAULT_CHUNK_SIZE;
+    bool huge_pages = argc > 2 && strcmp(argv[2], "huge") == 0;
+    if (blocks == 0 || chunk_size == 0) {
+        printf("Usage: grow [blocks] [chunk KB] [huge]\n");
+        return 1;
+    }
+    
+    MemoryPool* pool = create_growable_memory_pool(chunk_size, POOL_SEGREGATED_FIT, huge_pages);
+    void** slots = (void**)calloc(blocks, sizeof(void*));
+    if (!pool || !slots) {
+        printf("Failed to set up growth benchmark\n");
+        exit(1);
+    }
+    
+    printf("%-22s %10s %8s %12s %12s\n", "phase", "blocks", "chunks", "mapped MB", "resident MB");
+    print_grow_phase("start", pool);
+    
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    double start = now_seconds();
+    for (size_t i = 0; i < blocks; i++) {
+        uint64_t r = next_random(&rng);
+        slots[i] = pool_alloc(pool, 1 + (r >> 40) % CHURN_MAX_REQUEST);
+        if (!slots[i]) {
+            printf("Allocation %zu failed\n", i);
+            exit(1);
+        }
+        memset(slots[i], 0xA5, 1);
+    }
+    double elapsed = now_seconds() - start;
+    print_grow_phase("peak", pool);
+    
+    // Survivors keep every chunk partly in use
+    for (size_t i = 0; i < blocks; i++) {
+        if (i % GROW_KEEP_EVERY != 0) {
+            pool_free(pool, slots[i]);
+            slots[i] = NULL;
+        }
+    }
+    print_grow_phase("kept 1 in 16", pool);
+    
+    for (size_t i = 0; i < blocks; i++) {
+        pool_free(pool, slots[i]);
+    }
+    print_grow_phase("all freed", pool);
+    
+    printf("\nGrowth: %.1f ns per allocation, %s pages\n", elapsed * 1e9 / blocks,
+           huge_pages ? "huge" : "regular");
+    
+    free(slots);
+    free_memory_pool(pool);
+    return 0;
+}
+
+// Allocator under test in the thread scaling benchmark
+typedef enum {
+    ALLOC_MALLOC,
+    ALLOC_LOCKED_POOL,
+    ALLOC_THREAD_CACHE
+} ThreadAllocator;
+
+// Per-thread arguments of the thread scaling benchmark
+typedef struct {
+    ThreadAllocator allocator;
+    SharedPool* shared;
+    _Atomic(void*)* exchange;
+    size_t ops;
+    uint64_t seed;
+    size_t failures;
+} ThreadChurnArgs;
+
+// Function to allocate through the allocator under test
+void* bench_alloc(ThreadAllocator allocator, SharedPool* shared, ThreadCache* cache, size_t size) {
+    if (allocator == ALLOC_MALLOC) {
+        return malloc(size);
+    }
+    if (allocator == ALLOC_THREAD_CACHE) {
+        return cache_alloc(cache, size);
+    }
+    
+    pthread_mutex_lock(&shared->lock);
+    void* ptr = pool_alloc(shared->pool, size);
+    pthread_mutex_unlock(&shared->lock);
+    return ptr;
+}
+
+// Function to free through the allocator under test
+void bench_free(ThreadAllocator allocator, SharedPool* shared, ThreadCache* cache, void* ptr) {
+    if (allocator == ALLOC_MALLOC) {
+        free(ptr);
+    } else if (allocator == ALLOC_THREAD_CACHE) {
+        cache_free(cache, ptr);
+    } else if (ptr) {
+        shared_free(shared, ptr);
+    }
+}
+
+// Function to run free/alloc churn on one thread. One free in eight is
+// swapped through a shared exchange slot first, so threads regularly free
+// blocks that other threads allocated.
+void* thread_churn_worker(void* arg) {
+    ThreadChurnArgs* args = (ThreadChurnArgs*)arg;
+    ThreadCache* cache = NULL;
+    if (args->allocator == ALLOC_THREAD_CACHE) {
+        cache = thread_cache_attach(args->shared);
+        if (!cache) {
+            exit(1);
+        }
+    }
+    
+    void* slots[THREADS_LIVE] = {NULL};
+    uint64_t rng = args->seed;
+    for (size_t i = 0; i < args->ops; i++) {
+        uint64_t r = next_random(&rng);
+        size_t slot = r % THREADS_LIVE;
+        size_t size = 1 + (r >> 40) % THREADS_MAX_REQUEST;
+        
+        void* old = slots[slot];
+        if ((r >> 32) % 8 == 0) {
+            old = atomic_exchange(&args->exchange[(r >> 16) % THREADS_EXCHANGE_SLOTS], old);
+        }
+        bench_free(args->allocator, args->shared, cache, old);
+        slots[slot] = bench_alloc(args->allocator, args->shared, cache, size);
+        if (!slots[slot]) {
+            args->failures++;
+        }
+    }
+    
+    for (size_t i = 0; i < THREADS_LIVE; i++) {
+        bench_free(args->allocator, args->shared, cache, slots[i]);
+    }
+    if (cache) {
+        thread_cache_detach(cache);
+    }
+    return NULL;
+}
+
+// Function to run the churn on a number of threads and print throughput
+void run_thread_scaling(ThreadAllocator allocator, int threads, size_t ops) {
+    SharedPool* shared = allocator == ALLOC_MALLOC ? NULL : create_shared_pool(THREADS_POOL_SIZE);
+    _Atomic(void*)* exchange = (_Atomic(void*)*)calloc(THREADS_EXCHANGE_SLOTS, sizeof(*exchange));
+    if ((allocator != ALLOC_MALLOC && !shared) || !exchange) {
+        printf("Failed to set up thread benchmark\n");
+        exit(1);
+    }
+    
+    pthread_t workers[THREADS_MAX];
+    ThreadChurnArgs args[THREADS_MAX];
+    
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        args[i].allocator = allocator;
+        args[i].shared = shared;
+        args[i].exchange = exchange;
+        args[i].ops = ops;
+        args[i].seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+        args[i].failures = 0;
+        pthread_create(&workers[i], NULL, thread_churn_worker, &args[i]);
+    }
+    size_t failures = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+        failures += args[i].failures;
+    }
+    double elapsed = now_seconds() - start;
+    
+    // Release whatever is still parked in the exchange slots
+    ThreadCache* cache = allocator == ALLOC_THREAD_CACHE ? thread_cache_attach(shared) : NULL;
+    for (size_t i = 0; i < THREADS_EXCHANGE_SLOTS; i++) {
+        bench_free(allocator, shared, cache, atomic_load(&exchange[i]));
+    }
+    if (cache) {
+        thread_cache_detach(cache);
+    }
+    
+    const char* name = allocator == ALLOC_MALLOC ? "malloc"
+                     : allocator == ALLOC_LOCKED_POOL ? "locked-pool" : "thread-cache";
+    printf("%-14s %8d %12.2f %10zu %12zu\n", name, threads,
+           (double)ops * threads / elapsed / 1e6, failures,
+           shared ? shared->pool->block_count : 0);
+    
+    free(exchange);
+    free_shared_pool(shared);
+}
+
+// Function to compare glibc malloc, a mutex-wrapped pool and the thread
+// caches from 1 up to max_threads threads
+int run_threads_benchmark(int argc, char** argv) {
+    int max_threads = argc > 0 ? atoi(argv[0]) : THREADS_DEFAULT_MAX;
+    size_t ops = argc > 1 ? strtoull(argv[1], NULL, 10) : THREADS_DEFAULT_OPS;
+    if (max_threads < 1 || max_threads > THREADS_MAX || ops == 0) {
+        printf("Usage: threads [max threads 1-%d] [ops per thread]\n", THREADS_MAX);
+        return 1;
+    }
+    
+    printf("%-14s %8s %12s %10s %12s\n", "allocator", "threads", "Mops/s", "failures", "leaked");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        run_thread_scaling(ALLOC_MALLOC, threads, ops);
+        run_thread_scaling(ALLOC_LOCKED_POOL, threads, ops);
+        run_thread_scaling(ALLOC_THREAD_CACHE, threads, ops);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // "bench [ops] [live blocks]" compares the allocation strategies
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return run_churn_benchmark(argc - 2, argv + 2);
+    }
+    // "frag [ops] [live blocks]" reports fragmentation over time
+    if (argc > 1 && strcmp(argv[1], "frag") == 0) {
+        return run_fragmentation_benchmark(argc - 2, argv + 2);
+    }
+    // "stats [ops] [sample period]" exercises the instrumentation
+    if (argc > 1 && strcmp(argv[1], "stats") == 0) {
+        return run_stats_benchmark(argc - 2, argv + 2);
+    }
+    // "grow [blocks] [chunk KB] [huge]" shows a growable pool's memory
+    // following its live set
+    if (argc > 1 && strcmp(argv[1], "grow") == 0) {
+        return run_grow_benchmark(argc - 2, argv + 2);
+    }
+    // "threads [max threads] [ops per thread]" compares multi-threaded
+    // allocation against glibc malloc
+    if (argc > 1 && strcmp(argv[1], "threads") == 0) {
+        return run_threads_benchmark(argc - 2, argv + 2);
+    }
+    
     // Create memory pool
     MemoryPool* pool = create_memory_pool(POOL_SIZE);
     if (!pool) {
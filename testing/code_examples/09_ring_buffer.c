@@ -1,20 +1,55 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
 
 #define RING_BUFFER_SIZE 8
+#define CACHE_LINE 64
+
+// Failed attempts spent spinning before a waiting thread yields its core
+#define SPIN_LIMIT 64
+
+// Cross-thread benchmark parameters
+#define BENCH_DEFAULT_ITEMS 2000000
+#define BENCH_DEFAULT_CAPACITY 1024
+#define BENCH_MAX_THREADS 16
+#define LATENCY_ROUND_TRIPS 100000
+#define BULK_DEFAULT_BATCH 64
+#define MIRROR_DEFAULT_BATCH 1000
 
 // Ring buffer structure
 typedef struct {
     int* buffer;
-    size_t size;
+    size_t size;  // Always a power of two
+    size_t mask;  // size - 1
     size_t head;
     size_t tail;
     size_t count;
     bool is_full;
+    // The array is mapped twice back to back, so buffer[i + size] is
+    // buffer[i] and any run of up to size elements is contiguous
+    bool mirrored;
 } RingBuffer;
 
+// Function to round a capacity up to a power of two, so positions can be
+// masked instead of taken modulo
+size_t round_up_pow2(size_t size) {
+    size_t capacity = 1;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
 // Function to create a new ring buffer
 RingBuffer* create_ring_buffer(size_t size) {
     RingBuffer* rb = (RingBuffer*)malloc(sizeof(RingBuffer));
@@ -23,6 +58,7 @@ RingBuffer* create_ring_buffer(size_t size) {
         return NULL;
     }
     
+    size = round_up_pow2(size);
     rb->buffer = (int*)malloc(size * sizeof(int));
     if (!rb->buffer) {
         printf("Failed to allocate ring buffer memory\n");
@@ -31,10 +67,60 @@ RingBuffer* create_ring_buffer(size_t size) {
     }
     
     rb->size = size;
+    rb->mask = size - 1;
+    rb->head = 0;
+    rb->tail = 0;
+    rb->count = 0;
+    rb->is_full = false;
+    rb->mirrored = false;
+    
+    return rb;
+}
+
+// Function to create a ring buffer whose array is mapped twice, back to
+// back, from one memfd. The capacity is rounded up to whole pages.
+RingBuffer* create_mirrored_ring_buffer(size_t size) {
+    RingBuffer* rb = (RingBuffer*)malloc(sizeof(RingBuffer));
+    if (!rb) {
+        printf("Failed to allocate ring buffer structure\n");
+        return NULL;
+    }
+    
+    size_t bytes = round_up_pow2(size * sizeof(int));
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if (bytes < page_size) {
+        bytes = page_size;
+    }
+    
+    // Reserve twice the span, then map the same file pages over each half
+    int fd = memfd_create("ring_buffer", MFD_CLOEXEC);
+    uint8_t* base = MAP_FAILED;
+    if (fd >= 0 && ftruncate(fd, bytes) == 0) {
+        base = (uint8_t*)mmap(NULL, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (base != MAP_FAILED &&
+        (mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+         mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+        munmap(base, 2 * bytes);
+        base = MAP_FAILED;
+    }
+    if (fd >= 0) {
+        close(fd);  // The mappings keep the memory alive
+    }
+    if (base == MAP_FAILED) {
+        printf("Failed to map mirrored ring buffer memory\n");
+        free(rb);
+        return NULL;
+    }
+    
+    rb->buffer = (int*)base;
+    rb->size = bytes / sizeof(int);
+    rb->mask = rb->size - 1;
     rb->head = 0;
     rb->tail = 0;
     rb->count = 0;
     rb->is_full = false;
+    rb->mirrored = true;
     
     return rb;
 }
@@ -67,7 +153,7 @@ bool enqueue(RingBuffer* rb, int value) {
     }
     
     rb->buffer[rb->tail] = value;
-    rb->tail = (rb->tail + 1) % rb->size;
+    rb->tail = (rb->tail + 1) & rb->mask;
     rb->count++;
     
     if (rb->tail == rb->head) {
@@ -85,7 +171,7 @@ bool dequeue(RingBuffer* rb, int* value) {
     }
     
     *value = rb->buffer[rb->head];
-    rb->head = (rb->head + 1) % rb->size;
+    rb->head = (rb->head + 1) & rb->mask;
     rb->count--;
     rb->is_full = false;
     
@@ -103,6 +189,81 @@ bool peek(RingBuffer* rb, int* value) {
     return true;
 }
 
+// Function to enqueue up to n elements, returning how many fit. The run
+// is copied with at most two memcpy calls, split where the array wraps,
+// or one when the buffer is mirrored.
+size_t enqueue_bulk(RingBuffer* rb, const int* values, size_t n) {
+    if (n > get_available(rb)) {
+        n = get_available(rb);
+    }
+    
+    size_t first = !rb->mirrored && rb->size - rb->tail < n ? rb->size - rb->tail : n;
+    memcpy(rb->buffer + rb->tail, values, first * sizeof(int));
+    memcpy(rb->buffer, values + first, (n - first) * sizeof(int));
+    
+    rb->tail = (rb->tail + n) & rb->mask;
+    rb->count += n;
+    rb->is_full = rb->count == rb->size;
+    return n;
+}
+
+// Function to dequeue up to n elements, returning how many were taken
+size_t dequeue_bulk(RingBuffer* rb, int* values, size_t n) {
+    if (n > rb->count) {
+        n = rb->count;
+    }
+    
+    size_t first = !rb->mirrored && rb->size - rb->head < n ? rb->size - rb->head : n;
+    memcpy(values, rb->buffer + rb->head, first * sizeof(int));
+    memcpy(values + first, rb->buffer, (n - first) * sizeof(int));
+    
+    rb->head = (rb->head + n) & rb->mask;
+    rb->count -= n;
+    rb->is_full = rb->count == rb->size;  // Still full if n was 0
+    return n;
+}
+
+// Function to reserve room for up to n elements to be written in place.
+// Returns the free run at the tail and its length in *reserved: at most
+// n, and unless the buffer is mirrored never past the end of the array,
+// so a request that wraps takes two reserve/commit rounds. Nothing is
+// visible until enqueue_commit.
+int* enqueue_reserve(RingBuffer* rb, size_t n, size_t* reserved) {
+    size_t run = rb->mirrored ? rb->size : rb->size - rb->tail;
+    if (run > get_available(rb)) {
+        run = get_available(rb);
+    }
+    *reserved = run < n ? run : n;
+    return rb->buffer + rb->tail;
+}
+
+// Function to publish the first n elements written after enqueue_reserve
+void enqueue_commit(RingBuffer* rb, size_t n) {
+    rb->tail = (rb->tail + n) & rb->mask;
+    rb->count += n;
+    rb->is_full = rb->count == rb->size;
+}
+
+// Function to look at up to n queued elements in place. Returns the run
+// at the head and its length in *reserved, which stops where the array
+// wraps unless the buffer is mirrored; the elements stay queued until
+// dequeue_commit.
+const int* dequeue_reserve(RingBuffer* rb, size_t n, size_t* reserved) {
+    size_t run = rb->mirrored ? rb->size : rb->size - rb->head;
+    if (run > rb->count) {
+        run = rb->count;
+    }
+    *reserved = run < n ? run : n;
+    return rb->buffer + rb->head;
+}
+
+// Function to release the first n elements read after dequeue_reserve
+void dequeue_commit(RingBuffer* rb, size_t n) {
+    rb->head = (rb->head + n) & rb->mask;
+    rb->count -= n;
+    rb->is_full = rb->count == rb->size;  // Still full if n was 0
+}
+
 // Function to clear the buffer
 void clear(RingBuffer* rb) {
     rb->head = 0;
@@ -128,7 +289,7 @@ void print_buffer(RingBuffer* rb) {
     
     while (count < rb->count) {
         printf("%d ", rb->buffer[current]);
-        current = (current + 1) % rb->size;
+        current = (current + 1) & rb->mask;
         count++;
     }
     printf("\n");
@@ -136,13 +297,1037 @@ void print_buffer(RingBuffer* rb) {
 
 // Function to free the ring buffer
 void free_ring_buffer(RingBuffer* rb) {
+    if (rb) {
+        if (rb->mirrored) {
+            munmap(rb->buffer, 2 * rb->size * sizeof(int));
+        } else {
+            free(rb->buffer);
+        }
+        free(rb);
+    }
+}
+
+// Macro to define a ring buffer of fixed-size records: a struct called
+// name holding elements of type, and name_create/_count/_push/_pop/
+// _push_bulk/_pop_bulk/_free. Unlike RingBuffer it keeps no count or
+// full flag: head and tail run freely, their difference is the count, and
+// the capacity is a power of two so a position is tail & mask.
+#define DEFINE_RING_BUFFER(name, type)                                             \
+typedef struct {                                                                   \
+    type* buffer;                                                                  \
+    size_t capacity;  /* Always a power of two */                                  \
+    size_t mask;                                                                   \
+    size_t head;      /* Total elements ever popped */                             \
+    size_t tail;      /* Total elements ever pushed */                             \
+} name;                                                                            \
+                                                                                   \
+name* name##_create(size_t capacity) {                                             \
+    name* rb = (name*)malloc(sizeof(name));                                        \
+    if (!rb) {                                                                     \
+        printf("Failed to allocate ring buffer structure\n");                      \
+        return NULL;                                                               \
+    }                                                                              \
+                                                                                   \
+    rb->capacity = round_up_pow2(capacity);                                        \
+    rb->mask = rb->capacity - 1;                                                   \
+    rb->buffer = (type*)malloc(rb->capacity * sizeof(type));                       \
+    if (!rb->buffer) {                                                             \
+        printf("Failed to allocate ring buffer memory\n");                         \
+        free(rb);                                                                  \
+        return NULL;                                                               \
+    }                                                                              \
+    rb->head = 0;                                                                  \
+    rb->tail = 0;                                                                  \
+    return rb;                                                                     \
+}                                                                                  \
+                                                                                   \
+size_t name##_count(name* rb) {                                                    \
+    return rb->tail - rb->head;                                                    \
+}                                                                                  \
+                                                                                   \
+bool name##_push(name* rb, const type* value) {                                    \
+    if (rb->tail - rb->head == rb->capacity) {                                     \
+        return false;                                                              \
+    }                                                                              \
+    rb->buffer[rb->tail & rb->mask] = *value;                                      \
+    rb->tail++;                                                                    \
+    return true;                                                                   \
+}                                                                                  \
+                                                                                   \
+bool name##_pop(name* rb, type* value) {                                           \
+    if (rb->tail == rb->head) {                                                    \
+        return false;                                                              \
+    }                                                                              \
+    *value = rb->buffer[rb->head & rb->mask];                                      \
+    rb->head++;                                                                    \
+    return true;                                                                   \
+}                                                                                  \
+                                                                                   \
+size_t name##_push_bulk(name* rb, const type* values, size_t n) {                  \
+    size_t space = rb->capacity - (rb->tail - rb->head);                           \
+    n = n < space ? n : space;                                                     \
+    size_t offset = rb->tail & rb->mask;                                           \
+    size_t first = rb->capacity - offset < n ? rb->capacity - offset : n;          \
+    memcpy(rb->buffer + offset, values, first * sizeof(type));                     \
+    memcpy(rb->buffer, values + first, (n - first) * sizeof(type));                \
+    rb->tail += n;                                                                 \
+    return n;                                                                      \
+}                                                                                  \
+                                                                                   \
+size_t name##_pop_bulk(name* rb, type* values, size_t n) {                         \
+    size_t count = rb->tail - rb->head;                                            \
+    n = n < count ? n : count;                                                     \
+    size_t offset = rb->head & rb->mask;                                           \
+    size_t first = rb->capacity - offset < n ? rb->capacity - offset : n;          \
+    memcpy(values, rb->buffer + offset, first * sizeof(type));                     \
+    memcpy(values + first, rb->buffer, (n - first) * sizeof(type));                \
+    rb->head += n;                                                                 \
+    return n;                                                                      \
+}                                                                                  \
+                                                                                   \
+void name##_free(name* rb) {                                                       \
+    if (rb) {                                                                      \
+        free(rb->buffer);                                                          \
+        free(rb);                                                                  \
+    }                                                                              \
+}
+
+// Single-producer/single-consumer lock-free ring buffer. head and tail
+// count elements ever dequeued/enqueued and sit on their own cache lines;
+// each side also keeps a private copy of the other side's index and only
+// reloads it (one cross-core cache miss) when the copy says the buffer is
+// full or empty.
+typedef struct {
+    // Producer's line
+    _Atomic size_t tail __attribute__((aligned(CACHE_LINE)));
+    size_t cached_head;
+    // Consumer's line
+    _Atomic size_t head __attribute__((aligned(CACHE_LINE)));
+    size_t cached_tail;
+    // Read-only after creation
+    int* buffer __attribute__((aligned(CACHE_LINE)));
+    size_t size;
+    size_t mask;
+} SpscRingBuffer;
+
+// Function to create a new SPSC ring buffer
+SpscRingBuffer* create_spsc_ring_buffer(size_t size) {
+    SpscRingBuffer* rb = (SpscRingBuffer*)aligned_alloc(CACHE_LINE, sizeof(SpscRingBuffer));
+    if (!rb) {
+        printf("Failed to allocate ring buffer structure\n");
+        return NULL;
+    }
+    
+    size = round_up_pow2(size);
+    rb->buffer = (int*)malloc(size * sizeof(int));
+    if (!rb->buffer) {
+        printf("Failed to allocate ring buffer memory\n");
+        free(rb);
+        return NULL;
+    }
+    
+    rb->size = size;
+    rb->mask = size - 1;
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+    rb->cached_head = 0;
+    rb->cached_tail = 0;
+    
+    return rb;
+}
+
+// Function to enqueue an element; producer thread only
+bool spsc_enqueue(SpscRingBuffer* rb, int value) {
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    if (tail - rb->cached_head == rb->size) {
+        rb->cached_head = atomic_load_explicit(&rb->head, memory_order_acquire);
+        if (tail - rb->cached_head == rb->size) {
+            return false;  // Full
+        }
+    }
+    
+    rb->buffer[tail & rb->mask] = value;
+    atomic_store_explicit(&rb->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Function to dequeue an element; consumer thread only
+bool spsc_dequeue(SpscRingBuffer* rb, int* value) {
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    if (head == rb->cached_tail) {
+        rb->cached_tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+        if (head == rb->cached_tail) {
+            return false;  // Empty
+        }
+    }
+    
+    *value = rb->buffer[head & rb->mask];
+    atomic_store_explicit(&rb->head, head + 1, memory_order_release);
+    return true;
+}
+
+// Function to enqueue up to n elements with one index update, returning
+// how many fit; producer thread only
+size_t spsc_enqueue_bulk(SpscRingBuffer* rb, const int* values, size_t n) {
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    if (rb->size - (tail - rb->cached_head) < n) {
+        rb->cached_head = atomic_load_explicit(&rb->head, memory_order_acquire);
+        if (rb->size - (tail - rb->cached_head) < n) {
+            n = rb->size - (tail - rb->cached_head);
+        }
+    }
+    
+    size_t offset = tail & rb->mask;
+    size_t first = rb->size - offset < n ? rb->size - offset : n;
+    memcpy(rb->buffer + offset, values, first * sizeof(int));
+    memcpy(rb->buffer, values + first, (n - first) * sizeof(int));
+    
+    atomic_store_explicit(&rb->tail, tail + n, memory_order_release);
+    return n;
+}
+
+// Function to dequeue up to n elements with one index update, returning
+// how many were taken; consumer thread only
+size_t spsc_dequeue_bulk(SpscRingBuffer* rb, int* values, size_t n) {
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    if (rb->cached_tail - head < n) {
+        rb->cached_tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+        if (rb->cached_tail - head < n) {
+            n = rb->cached_tail - head;
+        }
+    }
+    
+    size_t offset = head & rb->mask;
+    size_t first = rb->size - offset < n ? rb->size - offset : n;
+    memcpy(values, rb->buffer + offset, first * sizeof(int));
+    memcpy(values + first, rb->buffer, (n - first) * sizeof(int));
+    
+    atomic_store_explicit(&rb->head, head + n, memory_order_release);
+    return n;
+}
+
+// Function to reserve room for up to n elements to be written in place,
+// as enqueue_reserve; producer thread only
+int* spsc_enqueue_reserve(SpscRingBuffer* rb, size_t n, size_t* reserved) {
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    size_t offset = tail & rb->mask;
+    size_t run = rb->size - offset;
+    if (rb->size - (tail - rb->cached_head) < (run < n ? run : n)) {
+        rb->cached_head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    }
+    
+    size_t space = rb->size - (tail - rb->cached_head);
+    if (run > space) {
+        run = space;
+    }
+    *reserved = run < n ? run : n;
+    return rb->buffer + offset;
+}
+
+// Function to hand the first n reserved elements to the consumer
+void spsc_enqueue_commit(SpscRingBuffer* rb, size_t n) {
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    atomic_store_explicit(&rb->tail, tail + n, memory_order_release);
+}
+
+// Function to look at up to n queued elements in place, as
+// dequeue_reserve; consumer thread only
+const int* spsc_dequeue_reserve(SpscRingBuffer* rb, size_t n, size_t* reserved) {
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    size_t offset = head & rb->mask;
+    size_t run = rb->size - offset;
+    if (rb->cached_tail - head < (run < n ? run : n)) {
+        rb->cached_tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    }
+    
+    if (run > rb->cached_tail - head) {
+        run = rb->cached_tail - head;
+    }
+    *reserved = run < n ? run : n;
+    return rb->buffer + offset;
+}
+
+// Function to hand the first n reserved slots back to the producer
+void spsc_dequeue_commit(SpscRingBuffer* rb, size_t n) {
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    atomic_store_explicit(&rb->head, head + n, memory_order_release);
+}
+
+// Function to free an SPSC ring buffer
+void free_spsc_ring_buffer(SpscRingBuffer* rb) {
     if (rb) {
         free(rb->buffer);
         free(rb);
     }
 }
 
-int main() {
+// Slot of an MPMC ring buffer. sequence says whose turn the slot is: equal
+// to the position, it is free for the producer claiming that position;
+// position + 1, it holds a value for the consumer claiming that position.
+typedef struct {
+    _Atomic size_t sequence;
+    int value;
+} MpmcSlot;
+
+// Multi-producer/multi-consumer lock-free ring buffer with per-slot
+// sequence numbers. Producers and consumers each claim positions with a
+// CAS on their own counter, then hand the slot over through its sequence.
+typedef struct {
+    _Atomic size_t enqueue_pos __attribute__((aligned(CACHE_LINE)));
+    _Atomic size_t dequeue_pos __attribute__((aligned(CACHE_LINE)));
+    MpmcSlot* slots __attribute__((aligned(CACHE_LINE)));
+    size_t size;
+    size_t mask;
+} MpmcRingBuffer;
+
+// Function to create a new MPMC ring buffer
+MpmcRingBuffer* create_mpmc_ring_buffer(size_t size) {
+    // With one slot, a full slot's sequence would match the empty mark of
+    // the next lap and a second producer would overwrite it
+    if (size < 2) {
+        printf("MPMC ring buffer needs at least 2 slots\n");
+        return NULL;
+    }
+    
+    MpmcRingBuffer* rb = (MpmcRingBuffer*)aligned_alloc(CACHE_LINE, sizeof(MpmcRingBuffer));
+    if (!rb) {
+        printf("Failed to allocate ring buffer structure\n");
+        return NULL;
+    }
+    
+    size = round_up_pow2(size);
+    rb->slots = (MpmcSlot*)malloc(size * sizeof(MpmcSlot));
+    if (!rb->slots) {
+        printf("Failed to allocate ring buffer memory\n");
+        free(rb);
+        return NULL;
+    }
+    
+    rb->size = size;
+    rb->mask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&rb->slots[i].sequence, i);
+    }
+    atomic_init(&rb->enqueue_pos, 0);
+    atomic_init(&rb->dequeue_pos, 0);
+    
+    return rb;
+}
+
+// Function to enqueue an element from any thread
+bool mpmc_enqueue(MpmcRingBuffer* rb, int value) {
+    size_t pos = atomic_load_explicit(&rb->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        MpmcSlot* slot = &rb->slots[pos & rb->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        
+        if (diff == 0) {
+            // Slot is free for this position; claim the position
+            if (atomic_compare_exchange_weak_explicit(&rb->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->value = value;
+                atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;  // Full: the slot still holds a value from one lap ago
+        } else {
+            pos = atomic_load_explicit(&rb->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Function to dequeue an element from any thread
+bool mpmc_dequeue(MpmcRingBuffer* rb, int* value) {
+    size_t pos = atomic_load_explicit(&rb->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        MpmcSlot* slot = &rb->slots[pos & rb->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&rb->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *value = slot->value;
+                // Free the slot for the producer one lap ahead
+                atomic_store_explicit(&slot->sequence, pos + rb->size, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;  // Empty
+        } else {
+            pos = atomic_load_explicit(&rb->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Function to free an MPMC ring buffer
+void free_mpmc_ring_buffer(MpmcRingBuffer* rb) {
+    if (rb) {
+        free(rb->slots);
+        free(rb);
+    }
+}
+
+// RingBuffer behind a mutex, the baseline for the lock-free variants
+typedef struct {
+    RingBuffer* rb;
+    pthread_mutex_t lock;
+} LockedRingBuffer;
+
+// Function to enqueue under the lock; a full buffer fails quietly
+bool locked_enqueue(LockedRingBuffer* q, int value) {
+    pthread_mutex_lock(&q->lock);
+    bool ok = !is_full(q->rb) && enqueue(q->rb, value);
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+// Function to dequeue under the lock; an empty buffer fails quietly
+bool locked_dequeue(LockedRingBuffer* q, int* value) {
+    pthread_mutex_lock(&q->lock);
+    bool ok = !is_empty(q->rb) && dequeue(q->rb, value);
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+// Function to read a monotonic clock in nanoseconds
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Function to wait after a failed attempt: spin briefly, then give the
+// core away so the other side can run even on a single CPU
+void backoff(unsigned* spins) {
+    if (++*spins < SPIN_LIMIT) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
+// Function to pin the calling thread to the index-th CPU the process may
+// run on (taskset, cgroup cpusets), wrapping around them
+void pin_to_cpu(int index) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        perror("sched_getaffinity failed");
+        return;
+    }
+    int count = CPU_COUNT(&allowed);
+    if (count == 0) {
+        return;
+    }
+    
+    int skip = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || skip-- > 0) {
+            continue;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (error != 0) {
+            printf("Failed to pin thread to CPU %d: %s\n", cpu, strerror(error));
+        }
+        return;
+    }
+}
+
+// Queue implementation under test
+typedef enum {
+    QUEUE_MUTEX,
+    QUEUE_SPSC,
+    QUEUE_MPMC
+} QueueKind;
+
+// One queue of any kind
+typedef struct {
+    QueueKind kind;
+    LockedRingBuffer locked;
+    SpscRingBuffer* spsc;
+    MpmcRingBuffer* mpmc;
+} BenchQueue;
+
+// Function to set up a benchmark queue of the given kind
+void bench_queue_init(BenchQueue* q, QueueKind kind, size_t capacity) {
+    q->kind = kind;
+    q->locked.rb = NULL;
+    q->spsc = NULL;
+    q->mpmc = NULL;
+    if (kind == QUEUE_MUTEX) {
+        q->locked.rb = create_ring_buffer(capacity);
+        pthread_mutex_init(&q->locked.lock, NULL);
+    } else if (kind == QUEUE_SPSC) {
+        q->spsc = create_spsc_ring_buffer(capacity);
+    } else {
+        q->mpmc = create_mpmc_ring_buffer(capacity);
+    }
+    if (!q->locked.rb && !q->spsc && !q->mpmc) {
+        exit(1);
+    }
+}
+
+// Function to release a benchmark queue
+void bench_queue_destroy(BenchQueue* q) {
+    if (q->kind == QUEUE_MUTEX) {
+        pthread_mutex_destroy(&q->locked.lock);
+        free_ring_buffer(q->locked.rb);
+    }
+    free_spsc_ring_buffer(q->spsc);
+    free_mpmc_ring_buffer(q->mpmc);
+}
+
+// Function to enqueue into a benchmark queue, waiting while it is full
+void bench_enqueue(BenchQueue* q, int value) {
+    unsigned spins = 0;
+    for (;;) {
+        bool ok = q->kind == QUEUE_SPSC ? spsc_enqueue(q->spsc, value)
+                : q->kind == QUEUE_MPMC ? mpmc_enqueue(q->mpmc, value)
+                : locked_enqueue(&q->locked, value);
+        if (ok) {
+            return;
+        }
+        backoff(&spins);
+    }
+}
+
+// Function to dequeue from a benchmark queue, waiting while it is empty
+int bench_dequeue(BenchQueue* q) {
+    unsigned spins = 0;
+    int value;
+    for (;;) {
+        bool ok = q->kind == QUEUE_SPSC ? spsc_dequeue(q->spsc, &value)
+                : q->kind == QUEUE_MPMC ? mpmc_dequeue(q->mpmc, &value)
+                : locked_dequeue(&q->locked, &value);
+        if (ok) {
+            return value;
+        }
+        backoff(&spins);
+    }
+}
+
+// Per-thread arguments of the throughput benchmark
+typedef struct {
+    BenchQueue* queue;
+    int cpu;
+    size_t items;
+    bool producer;
+    int64_t sum;
+} ThroughputArgs;
+
+// Function to move a thread's share of items through the queue
+void* throughput_worker(void* arg) {
+    ThroughputArgs* args = (ThroughputArgs*)arg;
+    pin_to_cpu(args->cpu);
+    
+    args->sum = 0;
+    for (size_t i = 0; i < args->items; i++) {
+        if (args->producer) {
+            bench_enqueue(args->queue, (int)(i & 0xFFFF));
+            args->sum += i & 0xFFFF;
+        } else {
+            args->sum += bench_dequeue(args->queue);
+        }
+    }
+    return NULL;
+}
+
+// Function to measure throughput with the given numbers of producers and
+// consumers, checking that every item arrived exactly once
+void run_throughput(QueueKind kind, const char* name, int producers, int consumers,
+                    size_t items, size_t capacity) {
+    BenchQueue queue;
+    bench_queue_init(&queue, kind, capacity);
+    
+    // Both sides must move the same total
+    items -= items % ((size_t)producers * consumers);
+    pthread_t threads[2 * BENCH_MAX_THREADS];
+    ThroughputArgs args[2 * BENCH_MAX_THREADS];
+    int count = producers + consumers;
+    
+    uint64_t start = now_ns();
+    for (int i = 0; i < count; i++) {
+        args[i].queue = &queue;
+        args[i].cpu = i;
+        args[i].producer = i < producers;
+        args[i].items = args[i].producer ? items / producers : items / consumers;
+        pthread_create(&threads[i], NULL, throughput_worker, &args[i]);
+    }
+    int64_t produced = 0, consumed = 0;
+    for (int i = 0; i < count; i++) {
+        pthread_join(threads[i], NULL);
+        if (args[i].producer) {
+            produced += args[i].sum;
+        } else {
+            consumed += args[i].sum;
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+    
+    char threads_label[32];
+    snprintf(threads_label, sizeof(threads_label), "%dP/%dC", producers, consumers);
+    printf("%-8s %10s %14.2f %10s\n", name, threads_label,
+           items * 1e3 / elapsed, produced == consumed ? "ok" : "MISMATCH");
+    bench_queue_destroy(&queue);
+}
+
+// Arguments of the echo side of the latency benchmark
+typedef struct {
+    BenchQueue* requests;
+    BenchQueue* replies;
+    size_t round_trips;
+} EchoArgs;
+
+// Function to send every request straight back
+void* echo_worker(void* arg) {
+    EchoArgs* args = (EchoArgs*)arg;
+    pin_to_cpu(1);
+    for (size_t i = 0; i < args->round_trips; i++) {
+        bench_enqueue(args->replies, bench_dequeue(args->requests));
+    }
+    return NULL;
+}
+
+// Function to order latency samples
+int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Function to measure round-trip latency through a pair of queues between
+// two threads and print percentiles
+void run_latency(QueueKind kind, const char* name, size_t round_trips) {
+    BenchQueue requests, replies;
+    bench_queue_init(&requests, kind, BENCH_DEFAULT_CAPACITY);
+    bench_queue_init(&replies, kind, BENCH_DEFAULT_CAPACITY);
+    uint64_t* samples = (uint64_t*)malloc(round_trips * sizeof(uint64_t));
+    if (!samples) {
+        exit(1);
+    }
+    
+    EchoArgs args = {&requests, &replies, round_trips};
+    pthread_t echo;
+    pthread_create(&echo, NULL, echo_worker, &args);
+    pin_to_cpu(0);
+    
+    for (size_t i = 0; i < round_trips; i++) {
+        uint64_t start = now_ns();
+        bench_enqueue(&requests, (int)i);
+        bench_dequeue(&replies);
+        samples[i] = now_ns() - start;
+    }
+    pthread_join(echo, NULL);
+    
+    qsort(samples, round_trips, sizeof(uint64_t), compare_u64);
+    printf("%-8s %12llu %12llu %12llu\n", name,
+           (unsigned long long)samples[round_trips / 2],
+           (unsigned long long)samples[round_trips * 99 / 100],
+           (unsigned long long)samples[round_trips * 999 / 1000]);
+    
+    free(samples);
+    bench_queue_destroy(&requests);
+    bench_queue_destroy(&replies);
+}
+
+// Function to compare the lock-free ring buffers with a mutex-wrapped
+// RingBuffer across threads
+int run_benchmark(int argc, char** argv) {
+    size_t items = argc > 0 ? strtoull(argv[0], NULL, 10) : BENCH_DEFAULT_ITEMS;
+    size_t capacity = argc > 1 ? strtoull(argv[1], NULL, 10) : BENCH_DEFAULT_CAPACITY;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    if (items == 0 || capacity < 2 || threads < 1 || threads > BENCH_MAX_THREADS) {
+        printf("Usage: bench [items] [capacity >= 2] [MPMC threads per side 1-%d]\n", BENCH_MAX_THREADS);
+        return 1;
+    }
+    
+    printf("Throughput (%ld CPUs online)\n%-8s %10s %14s %10s\n",
+           sysconf(_SC_NPROCESSORS_ONLN), "queue", "threads", "Mitems/s", "check");
+    run_throughput(QUEUE_MUTEX, "mutex", 1, 1, items, capacity);
+    run_throughput(QUEUE_SPSC, "spsc", 1, 1, items, capacity);
+    run_throughput(QUEUE_MPMC, "mpmc", 1, 1, items, capacity);
+    run_throughput(QUEUE_MUTEX, "mutex", threads, threads, items, capacity);
+    run_throughput(QUEUE_MPMC, "mpmc", threads, threads, items, capacity);
+    
+    size_t round_trips = items < LATENCY_ROUND_TRIPS ? items : LATENCY_ROUND_TRIPS;
+    printf("\nRound-trip latency (ns)\n%-8s %12s %12s %12s\n", "queue", "p50", "p99", "p99.9");
+    run_latency(QUEUE_MUTEX, "mutex", round_trips);
+    run_latency(QUEUE_SPSC, "spsc", round_trips);
+    run_latency(QUEUE_MPMC, "mpmc", round_trips);
+    return 0;
+}
+
+// Function to move items through a RingBuffer on one thread in rounds of
+// batch elements, one call per element, and return Mitems/s
+double run_single_element(RingBuffer* rb, size_t items, size_t batch, int64_t* sum) {
+    uint64_t start = now_ns();
+    for (size_t done = 0; done < items; done += batch) {
+        for (size_t i = 0; i < batch; i++) {
+            enqueue(rb, (int)(done + i));
+        }
+        int value = 0;
+        for (size_t i = 0; i < batch; i++) {
+            dequeue(rb, &value);
+            *sum += value;
+        }
+    }
+    return items * 1e3 / (now_ns() - start);
+}
+
+// Function to move the same rounds with enqueue_bulk/dequeue_bulk
+double run_single_bulk(RingBuffer* rb, size_t items, size_t batch, int64_t* sum) {
+    int* values = (int*)malloc(batch * sizeof(int));
+    if (!values) {
+        exit(1);
+    }
+    
+    uint64_t start = now_ns();
+    for (size_t done = 0; done < items; done += batch) {
+        for (size_t i = 0; i < batch; i++) {
+            values[i] = (int)(done + i);
+        }
+        enqueue_bulk(rb, values, batch);
+        dequeue_bulk(rb, values, batch);
+        for (size_t i = 0; i < batch; i++) {
+            *sum += values[i];
+        }
+    }
+    double rate = items * 1e3 / (now_ns() - start);
+    free(values);
+    return rate;
+}
+
+// Function to move the same rounds writing and reading in place
+double run_single_reserve(RingBuffer* rb, size_t items, size_t batch, int64_t* sum) {
+    uint64_t start = now_ns();
+    for (size_t done = 0; done < items; done += batch) {
+        size_t written = 0;
+        while (written < batch) {
+            size_t run;
+            int* slots = enqueue_reserve(rb, batch - written, &run);
+            if (run == 0) {
+                return 0;  // Ring full with the batch unwritten; no progress possible
+            }
+            for (size_t i = 0; i < run; i++) {
+                slots[i] = (int)(done + written + i);
+            }
+            enqueue_commit(rb, run);
+            written += run;
+        }
+        
+        size_t read = 0;
+        while (read < batch) {
+            size_t run;
+            const int* slots = dequeue_reserve(rb, batch - read, &run);
+            if (run == 0) {
+                return 0;  // Ring empty with the batch unread; no progress possible
+            }
+            for (size_t i = 0; i < run; i++) {
+                *sum += slots[i];
+            }
+            dequeue_commit(rb, run);
+            read += run;
+        }
+    }
+    return items * 1e3 / (now_ns() - start);
+}
+
+// Arguments of the bulk SPSC benchmark threads
+typedef struct {
+    SpscRingBuffer* rb;
+    size_t items;
+    size_t batch;  // 0 moves one element per call
+    int64_t sum;
+} SpscBulkArgs;
+
+// Function to produce items into an SPSC ring buffer
+void* spsc_bulk_producer(void* arg) {
+    SpscBulkArgs* args = (SpscBulkArgs*)arg;
+    pin_to_cpu(0);
+    
+    int values[BENCH_DEFAULT_CAPACITY];
+    unsigned spins = 0;
+    size_t done = 0;
+    while (done < args->items) {
+        size_t n = 0;
+        if (args->batch == 0) {
+            n = spsc_enqueue(args->rb, (int)(done & 0xFFFF)) ? 1 : 0;
+        } else {
+            size_t want = args->items - done < args->batch ? args->items - done : args->batch;
+            for (size_t i = 0; i < want; i++) {
+                values[i] = (int)((done + i) & 0xFFFF);
+            }
+            n = spsc_enqueue_bulk(args->rb, values, want);
+        }
+        
+        if (n == 0) {
+            backoff(&spins);
+            continue;
+        }
+        spins = 0;
+        for (size_t i = 0; i < n; i++) {
+            args->sum += (done + i) & 0xFFFF;
+        }
+        done += n;
+    }
+    return NULL;
+}
+
+// Function to consume items from an SPSC ring buffer
+void* spsc_bulk_consumer(void* arg) {
+    SpscBulkArgs* args = (SpscBulkArgs*)arg;
+    pin_to_cpu(1);
+    
+    int values[BENCH_DEFAULT_CAPACITY];
+    unsigned spins = 0;
+    size_t done = 0;
+    while (done < args->items) {
+        size_t n = args->batch == 0 ? (spsc_dequeue(args->rb, values) ? 1 : 0)
+                                    : spsc_dequeue_bulk(args->rb, values, args->batch);
+        if (n == 0) {
+            backoff(&spins);
+            continue;
+        }
+        spins = 0;
+        for (size_t i = 0; i < n; i++) {
+            args->sum += values[i];
+        }
+        done += n;
+    }
+    return NULL;
+}
+
+// Function to measure cross-thread SPSC throughput one element or one
+// batch per call
+void run_spsc_bulk(const char* name, size_t items, size_t batch) {
+    SpscRingBuffer* rb = create_spsc_ring_buffer(BENCH_DEFAULT_CAPACITY);
+    if (!rb) {
+        exit(1);
+    }
+    
+    SpscBulkArgs producer = {rb, items, batch, 0};
+    SpscBulkArgs consumer = {rb, items, batch, 0};
+    pthread_t threads[2];
+    uint64_t start = now_ns();
+    pthread_create(&threads[0], NULL, spsc_bulk_producer, &producer);
+    pthread_create(&threads[1], NULL, spsc_bulk_consumer, &consumer);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+    uint64_t elapsed = now_ns() - start;
+    
+    printf("%-22s %14.2f %10s\n", name, items * 1e3 / elapsed,
+           producer.sum == consumer.sum ? "ok" : "MISMATCH");
+    free_spsc_ring_buffer(rb);
+}
+
+// Function to compare per-element, bulk and in-place transfers
+int run_bulk_benchmark(int argc, char** argv) {
+    size_t items = argc > 0 ? strtoull(argv[0], NULL, 10) : BENCH_DEFAULT_ITEMS;
+    size_t batch = argc > 1 ? strtoull(argv[1], NULL, 10) : BULK_DEFAULT_BATCH;
+    RingBuffer* rb = create_ring_buffer(BENCH_DEFAULT_CAPACITY);
+    if (!rb) {
+        return 1;
+    }
+    // A batch must fit in the ring, or the single-threaded rounds stall
+    if (items == 0 || batch == 0 || batch > rb->size) {
+        printf("Usage: bulk [items] [batch 1-%zu]\n", rb->size);
+        free_ring_buffer(rb);
+        return 1;
+    }
+    items -= items % batch;
+    
+    // Start one slot in, so batches keep straddling the wrap point
+    int value;
+    enqueue(rb, 0);
+    dequeue(rb, &value);
+    
+    int64_t sums[3] = {0, 0, 0};
+    printf("%-22s %14s %10s\n", "transfer", "Mitems/s", "check");
+    double rate = run_single_element(rb, items, batch, &sums[0]);
+    printf("%-22s %14.2f %10s\n", "element", rate, "-");
+    rate = run_single_bulk(rb, items, batch, &sums[1]);
+    printf("%-22s %14.2f %10s\n", "bulk", rate, sums[1] == sums[0] ? "ok" : "MISMATCH");
+    rate = run_single_reserve(rb, items, batch, &sums[2]);
+    printf("%-22s %14.2f %10s\n", "reserve/commit", rate, sums[2] == sums[0] ? "ok" : "MISMATCH");
+    free_ring_buffer(rb);
+    
+    run_spsc_bulk("spsc element", items, 0);
+    run_spsc_bulk("spsc bulk", items, batch);
+    return 0;
+}
+
+// Macro to define a record type of the given size, its ring buffer and a
+// benchmark moving records one at a time and in bulk
+#define DEFINE_RECORD_BENCHMARK(bytes)                                             \
+typedef struct {                                                                   \
+    uint8_t data[bytes];                                                           \
+} Record##bytes;                                                                   \
+                                                                                   \
+DEFINE_RING_BUFFER(RecordRing##bytes, Record##bytes)                               \
+                                                                                   \
+void run_record_benchmark_##bytes(size_t items, size_t batch) {                    \
+    RecordRing##bytes* rb = RecordRing##bytes##_create(BENCH_DEFAULT_CAPACITY);    \
+    Record##bytes* records = (Record##bytes*)calloc(batch, sizeof(Record##bytes)); \
+    if (!rb || !records) {                                                         \
+        exit(1);                                                                   \
+    }                                                                              \
+                                                                                   \
+    uint64_t checksum = 0;                                                         \
+    uint64_t start = now_ns();                                                     \
+    for (size_t done = 0; done < items; done += batch) {                           \
+        for (size_t i = 0; i < batch; i++) {                                       \
+            records[i].data[0] = (uint8_t)(done + i);                              \
+            RecordRing##bytes##_push(rb, &records[i]);                             \
+        }                                                                          \
+        Record##bytes record;                                                      \
+        while (RecordRing##bytes##_pop(rb, &record)) {                             \
+            checksum += record.data[0];                                            \
+        }                                                                          \
+    }                                                                              \
+    uint64_t single = now_ns() - start;                                            \
+                                                                                   \
+    start = now_ns();                                                              \
+    for (size_t done = 0; done < items; done += batch) {                           \
+        for (size_t i = 0; i < batch; i++) {                                       \
+            records[i].data[0] = (uint8_t)(done + i);                              \
+        }                                                                          \
+        RecordRing##bytes##_push_bulk(rb, records, batch);                         \
+        RecordRing##bytes##_pop_bulk(rb, records, batch);                          \
+        for (size_t i = 0; i < batch; i++) {                                       \
+            checksum -= records[i].data[0];                                        \
+        }                                                                          \
+    }                                                                              \
+    uint64_t bulk = now_ns() - start;                                              \
+                                                                                   \
+    printf("%8d %14.2f %10.2f %14.2f %10.2f %8s\n", bytes,                         \
+           items * 1e3 / single, items * (double)bytes / single,                   \
+           items * 1e3 / bulk, items * (double)bytes / bulk,                       \
+           checksum == 0 ? "ok" : "MISMATCH");                                     \
+    free(records);                                                                 \
+    RecordRing##bytes##_free(rb);                                                  \
+}
+
+DEFINE_RECORD_BENCHMARK(4)
+DEFINE_RECORD_BENCHMARK(8)
+DEFINE_RECORD_BENCHMARK(16)
+DEFINE_RECORD_BENCHMARK(32)
+DEFINE_RECORD_BENCHMARK(64)
+DEFINE_RECORD_BENCHMARK(128)
+DEFINE_RECORD_BENCHMARK(256)
+
+// Function to benchmark generic ring buffers over record sizes
+int run_record_benchmark(int argc, char** argv) {
+    size_t items = argc > 0 ? strtoull(argv[0], NULL, 10) : BENCH_DEFAULT_ITEMS;
+    size_t batch = argc > 1 ? strtoull(argv[1], NULL, 10) : BULK_DEFAULT_BATCH;
+    if (items == 0 || batch == 0 || batch > BENCH_DEFAULT_CAPACITY) {
+        printf("Usage: records [items] [batch 1-%d]\n", BENCH_DEFAULT_CAPACITY);
+        return 1;
+    }
+    items -= items % batch;
+    
+    printf("%8s %14s %10s %14s %10s %8s\n", "bytes", "push Mitem/s", "GB/s",
+           "bulk Mitem/s", "GB/s", "check");
+    run_record_benchmark_4(items, batch);
+    run_record_benchmark_8(items, batch);
+    run_record_benchmark_16(items, batch);
+    run_record_benchmark_32(items, batch);
+    run_record_benchmark_64(items, batch);
+    run_record_benchmark_128(items, batch);
+    run_record_benchmark_256(items, batch);
+    return 0;
+}
+
+// Function to stream items through a ring buffer the way a writer of a
+// byte stream would: the producer appends batches, the consumer hands
+// everything readable to write() in place. Returns Mitems/s and counts
+// the write() calls in *writes.
+double run_mirror_stream(RingBuffer* rb, size_t items, size_t batch, int fd, size_t* writes) {
+    int* values = (int*)malloc(batch * sizeof(int));
+    if (!values) {
+        exit(1);
+    }
+    for (size_t i = 0; i < batch; i++) {
+        values[i] = (int)i;
+    }
+    
+    *writes = 0;
+    uint64_t start = now_ns();
+    for (size_t done = 0; done < items; done += batch) {
+        enqueue_bulk(rb, values, batch);
+        while (!is_empty(rb)) {
+            size_t run;
+            const int* data = dequeue_reserve(rb, rb->count, &run);
+            ssize_t written = write(fd, data, run * sizeof(int));
+            if (written < 0) {
+                exit(1);
+            }
+            dequeue_commit(rb, (size_t)written / sizeof(int));
+            (*writes)++;
+        }
+    }
+    double rate = items * 1e3 / (now_ns() - start);
+    free(values);
+    return rate;
+}
+
+// Function to compare write() streaming from a plain and a mirrored ring
+int run_mirror_benchmark(int argc, char** argv) {
+    size_t items = argc > 0 ? strtoull(argv[0], NULL, 10) : BENCH_DEFAULT_ITEMS;
+    size_t batch = argc > 1 ? strtoull(argv[1], NULL, 10) : MIRROR_DEFAULT_BATCH;
+    RingBuffer* plain = create_ring_buffer(BENCH_DEFAULT_CAPACITY);
+    RingBuffer* mirrored = create_mirrored_ring_buffer(BENCH_DEFAULT_CAPACITY);
+    if (!plain || !mirrored || items == 0 || batch == 0 || batch > plain->size) {
+        printf("Usage: mirror [items] [batch 1-%d]\n", BENCH_DEFAULT_CAPACITY);
+        free_ring_buffer(plain);
+        free_ring_buffer(mirrored);
+        return 1;
+    }
+    items -= items % batch;
+    
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd < 0) {
+        free_ring_buffer(plain);
+        free_ring_buffer(mirrored);
+        return 1;
+    }
+    
+    size_t writes;
+    printf("%-10s %10s %14s %16s\n", "buffer", "capacity", "Mitems/s", "writes/batch");
+    double rate = run_mirror_stream(plain, items, batch, fd, &writes);
+    printf("%-10s %10zu %14.2f %16.3f\n", "plain", plain->size, rate, (double)writes * batch / items);
+    rate = run_mirror_stream(mirrored, items, batch, fd, &writes);
+    printf("%-10s %10zu %14.2f %16.3f\n", "mirrored", mirrored->size, rate, (double)writes * batch / items);
+    
+    close(fd);
+    free_ring_buffer(plain);
+    free_ring_buffer(mirrored);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // "bench [items] [capacity] [threads]" compares the thread-safe variants
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return run_benchmark(argc - 2, argv + 2);
+    }
+    // "bulk [items] [batch]" compares per-element and batched transfers
+    if (argc > 1 && strcmp(argv[1], "bulk") == 0) {
+        return run_bulk_benchmark(argc - 2, argv + 2);
+    }
+    // "mirror [items] [batch]" compares streaming out of a mirrored ring
+    if (argc > 1 && strcmp(argv[1], "mirror") == 0) {
+        return run_mirror_benchmark(argc - 2, argv + 2);
+    }
+    // "records [items] [batch]" benchmarks generic rings by record size
+    if (argc > 1 && strcmp(argv[1], "records") == 0) {
+        return run_record_benchmark(argc - 2, argv + 2);
+    }
+    
     // Create ring buffer
     RingBuffer* rb = create_ring_buffer(RING_BUFFER_SIZE);
     if (!rb) {
@@ -4,21 +4,70 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #define BUFFER_SIZE 5
 #define NUM_PRODUCERS 2
 #define NUM_CONSUMERS 2
 #define NUM_ITEMS 10
+#define CONSUMER_BATCH 4  // Items a consumer drains per lock acquisition
+#define CACHE_LINE 64
+
+// Failed attempts a waiting thread spins through before it sleeps on a
+// futex
+#define SPIN_LIMIT 200
+
+// Pipeline mode parameters
+#define PIPELINE_MAX_THREADS 64  // per side
+#define PIPELINE_DEFAULT_THREADS 4
+#define PIPELINE_DEFAULT_ITEMS 1000000
+#define PIPELINE_DEFAULT_QUEUE 1024
+
+// Work-stealing executor parameters
+#define DEQUE_INITIAL_SIZE 256  // Tasks per worker deque, doubled when full
+#define DEQUE_ABORT ((Task*)1)  // Steal lost a race, worth retrying
+
+// Steal mode parameters
+#define STEAL_MAX_WORKERS 64
+#define STEAL_DEFAULT_WORKERS 4
+#define STEAL_DEFAULT_TASKS 200000
+#define STEAL_MAX_COST_SHIFT 12  // Heaviest task costs 2^12 units
+#define STEAL_UNIT_ITERATIONS 200
+#define STEAL_BUFFER_SIZE 64
+
+// Batch mode parameters
+#define BATCH_DEFAULT_SIZE 16
+#define BATCH_DEFAULT_BUFFER 256
+#define BATCH_MAX 1024
+#define STATS_HISTOGRAM_ROWS 16  // Depth histogram rows printed at most
+
+// Backpressure counters of a buffer, updated under its mutex
+typedef struct {
+    uint64_t puts;
+    uint64_t gets;
+    uint64_t get_locks;  // Lock acquisitions that took items
+    uint64_t full_waits;  // Producers that found the buffer full
+    uint64_t full_wait_ns;
+    uint64_t empty_waits;  // Consumers that found the buffer empty
+    uint64_t empty_wait_ns;
+    uint64_t* depth_histogram;  // Depth found by each put or get, 0 to size
+} BufferStats;
 
 // Buffer structure
 typedef struct {
     int* items;
+    int size;
     int in;
     int out;
     int count;
     pthread_mutex_t mutex;
     pthread_cond_t not_full;
     pthread_cond_t not_empty;
+    BufferStats stats;
 } Buffer;
 
 // Thread arguments structure
@@ -26,8 +75,16 @@ typedef struct {
     int id;
     Buffer* buffer;
     int num_items;
+    uint64_t elapsed_ns;  // Set by the thread when it finishes
 } ThreadArgs;
 
+// Function to read a monotonic clock in nanoseconds
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 // Function to initialize buffer
 Buffer* create_buffer(int size) {
     Buffer* buffer = (Buffer*)malloc(sizeof(Buffer));
@@ -43,6 +100,16 @@ Buffer* create_buffer(int size) {
         return NULL;
     }
     
+    memset(&buffer->stats, 0, sizeof(BufferStats));
+    buffer->stats.depth_histogram = (uint64_t*)calloc(size + 1, sizeof(uint64_t));
+    if (!buffer->stats.depth_histogram) {
+        printf("Failed to allocate buffer statistics\n");
+        free(buffer->items);
+        free(buffer);
+        return NULL;
+    }
+    
+    buffer->size = size;
     buffer->in = 0;
     buffer->out = 0;
     buffer->count = 0;
@@ -60,17 +127,42 @@ void free_buffer(Buffer* buffer) {
         pthread_mutex_destroy(&buffer->mutex);
         pthread_cond_destroy(&buffer->not_full);
         pthread_cond_destroy(&buffer->not_empty);
+        free(buffer->stats.depth_histogram);
         free(buffer->items);
         free(buffer);
     }
 }
 
+// Function to record the depth a put or get found; the caller holds the
+// mutex. Returns the time a wait starts, or 0 when the caller need not wait.
+uint64_t buffer_arrive(Buffer* buffer, bool putting) {
+    buffer->stats.depth_histogram[buffer->count]++;
+    bool blocked = putting ? buffer->count == buffer->size : buffer->count == 0;
+    return blocked ? now_ns() : 0;
+}
+
+// Function to account for a wait that started at wait_started, if any
+void buffer_waited(Buffer* buffer, bool putting, uint64_t wait_started) {
+    if (wait_started == 0) {
+        return;
+    }
+    uint64_t waited = now_ns() - wait_started;
+    if (putting) {
+        buffer->stats.full_waits++;
+        buffer->stats.full_wait_ns += waited;
+    } else {
+        buffer->stats.empty_waits++;
+        buffer->stats.empty_wait_ns += waited;
+    }
+}
+
 // Producer function
 void* producer(void* arg) {
     ThreadArgs* args = (ThreadArgs*)arg;
     Buffer* buffer = args->buffer;
     int id = args->id;
     int item;
+    uint64_t start = now_ns();
     
     for (int i = 0; i < args->num_items; i++) {
         // Generate item
@@ -80,15 +172,18 @@ void* producer(void* arg) {
         pthread_mutex_lock(&buffer->mutex);
         
         // Wait if buffer is full
-        while (buffer->count == BUFFER_SIZE) {
+        uint64_t wait_started = buffer_arrive(buffer, true);
+        while (buffer->count == buffer->size) {
             printf("Producer %d: Buffer full, waiting...\n", id);
             pthread_cond_wait(&buffer->not_full, &buffer->mutex);
         }
+        buffer_waited(buffer, true, wait_started);
         
         // Add item to buffer
         buffer->items[buffer->in] = item;
-        buffer->in = (buffer->in + 1) % BUFFER_SIZE;
+        buffer->in = (buffer->in + 1) % buffer->size;
         buffer->count++;
+        buffer->stats.puts++;
         
         printf("Producer %d: Produced item %d\n", id, item);
         
@@ -102,47 +197,1323 @@ void* producer(void* arg) {
         usleep(rand() % 100000);
     }
     
+    args->elapsed_ns = now_ns() - start;
     return NULL;
 }
 
-// Consumer function
+// Consumer function. Drains up to CONSUMER_BATCH items per lock
+// acquisition, then processes them outside the lock.
 void* consumer(void* arg) {
     ThreadArgs* args = (ThreadArgs*)arg;
     Buffer* buffer = args->buffer;
     int id = args->id;
     int item;
+    uint64_t start = now_ns();
     
-    for (int i = 0; i < args->num_items; i++) {
+    for (int i = 0; i < args->num_items; ) {
         // Lock mutex
         pthread_mutex_lock(&buffer->mutex);
         
         // Wait if buffer is empty
+        uint64_t wait_started = buffer_arrive(buffer, false);
         while (buffer->count == 0) {
             printf("Consumer %d: Buffer empty, waiting...\n", id);
             pthread_cond_wait(&buffer->not_empty, &buffer->mutex);
         }
+        buffer_waited(buffer, false, wait_started);
         
-        // Remove item from buffer
-        item = buffer->items[buffer->out];
-        buffer->out = (buffer->out + 1) % BUFFER_SIZE;
-        buffer->count--;
-        
-        printf("Consumer %d: Consumed item %d\n", id, item);
+        // Remove a batch of items from buffer
+        int taken = 0;
+        while (taken < CONSUMER_BATCH && buffer->count > 0 && i + taken < args->num_items) {
+            item = buffer->items[buffer->out];
+            buffer->out = (buffer->out + 1) % buffer->size;
+            buffer->count--;
+            taken++;
+            
+            printf("Consumer %d: Consumed item %d\n", id, item);
+        }
+        buffer->stats.gets += taken;
+        buffer->stats.get_locks++;
         
-        // Signal that buffer is not full
-        pthread_cond_signal(&buffer->not_full);
+        // Signal that buffer is not full; a batch frees room for several
+        // producers
+        if (taken > 1) {
+            pthread_cond_broadcast(&buffer->not_full);
+        } else {
+            pthread_cond_signal(&buffer->not_full);
+        }
         
         // Unlock mutex
         pthread_mutex_unlock(&buffer->mutex);
         
         // Simulate consumption time
-        usleep(rand() % 100000);
+        for (int j = 0; j < taken; j++) {
+            usleep(rand() % 100000);
+        }
+        i += taken;
     }
     
+    args->elapsed_ns = now_ns() - start;
     return NULL;
 }
 
-int main() {
+// Function to print how fast a thread moved its items
+void print_thread_throughput(const char* role, int id, size_t items, uint64_t elapsed_ns) {
+    printf("%s %d: %zu items in %.1f ms (%.0f items/s)\n", role, id, items, elapsed_ns / 1e6,
+           elapsed_ns ? items * 1e9 / elapsed_ns : 0.0);
+}
+
+// Function to add an item to the buffer, waiting while it is full
+void buffer_put(Buffer* buffer, int item) {
+    pthread_mutex_lock(&buffer->mutex);
+    uint64_t wait_started = buffer_arrive(buffer, true);
+    while (buffer->count == buffer->size) {
+        pthread_cond_wait(&buffer->not_full, &buffer->mutex);
+    }
+    buffer_waited(buffer, true, wait_started);
+    buffer->items[buffer->in] = item;
+    buffer->in = (buffer->in + 1) % buffer->size;
+    buffer->count++;
+    buffer->stats.puts++;
+    pthread_cond_signal(&buffer->not_empty);
+    pthread_mutex_unlock(&buffer->mutex);
+}
+
+// Function to take up to max items from the buffer in one lock
+// acquisition, waiting while it is empty. Returns the number taken.
+int buffer_get_batch(Buffer* buffer, int* items, int max) {
+    pthread_mutex_lock(&buffer->mutex);
+    uint64_t wait_started = buffer_arrive(buffer, false);
+    while (buffer->count == 0) {
+        pthread_cond_wait(&buffer->not_empty, &buffer->mutex);
+    }
+    buffer_waited(buffer, false, wait_started);
+    
+    int taken = 0;
+    while (taken < max && buffer->count > 0) {
+        items[taken++] = buffer->items[buffer->out];
+        buffer->out = (buffer->out + 1) % buffer->size;
+        buffer->count--;
+    }
+    buffer->stats.gets += taken;
+    buffer->stats.get_locks++;
+    
+    if (taken > 1) {
+        pthread_cond_broadcast(&buffer->not_full);
+    } else {
+        pthread_cond_signal(&buffer->not_full);
+    }
+    pthread_mutex_unlock(&buffer->mutex);
+    return taken;
+}
+
+// Function to print a buffer's backpressure counters. Long waits on
+// not_full with a deep histogram call for more consumers or a larger
+// buffer; long waits on not_empty with a shallow one mean producers are
+// the bottleneck.
+void print_buffer_stats(Buffer* buffer) {
+    pthread_mutex_lock(&buffer->mutex);
+    BufferStats* stats = &buffer->stats;
+    printf("Buffer statistics (size %d):\n", buffer->size);
+    printf("  Puts: %llu, gets: %llu in %llu lock acquisitions (%.2f per acquisition)\n",
+           (unsigned long long)stats->puts, (unsigned long long)stats->gets,
+           (unsigned long long)stats->get_locks,
+           stats->get_locks ? (double)stats->gets / stats->get_locks : 0.0);
+    printf("  Blocked on not_full: %llu waits, %.1f ms over all threads\n",
+           (unsigned long long)stats->full_waits, stats->full_wait_ns / 1e6);
+    printf("  Blocked on not_empty: %llu waits, %.1f ms over all threads\n",
+           (unsigned long long)stats->empty_waits, stats->empty_wait_ns / 1e6);
+    
+    // Depth found on arrival, merged into at most STATS_HISTOGRAM_ROWS rows
+    uint64_t arrivals = 0;
+    for (int depth = 0; depth <= buffer->size; depth++) {
+        arrivals += stats->depth_histogram[depth];
+    }
+    int per_row = (buffer->size + STATS_HISTOGRAM_ROWS) / STATS_HISTOGRAM_ROWS;
+    printf("  Depth on arrival:\n");
+    for (int first = 0; first <= buffer->size; first += per_row) {
+        int last = first + per_row - 1 < buffer->size ? first + per_row - 1 : buffer->size;
+        uint64_t count = 0;
+        for (int depth = first; depth <= last; depth++) {
+            count += stats->depth_histogram[depth];
+        }
+        char range[32];
+        if (first == last) {
+            snprintf(range, sizeof(range), "%d", first);
+        } else {
+            snprintf(range, sizeof(range), "%d-%d", first, last);
+        }
+        int bar = arrivals ? (int)(count * 40 / arrivals) : 0;
+        printf("    %9s %10llu %5.1f%% %.*s\n", range, (unsigned long long)count,
+               arrivals ? count * 100.0 / arrivals : 0.0, bar,
+               "########################################");
+    }
+    pthread_mutex_unlock(&buffer->mutex);
+}
+
+// Function to take an item from the buffer, waiting while it is empty
+int buffer_get(Buffer* buffer) {
+    int item;
+    buffer_get_batch(buffer, &item, 1);
+    return item;
+}
+
+// Slot of a handoff queue. sequence equal to the position means the slot
+// is free for the producer claiming that position; position + 1 means it
+// holds an item for the consumer claiming that position.
+typedef struct {
+    _Atomic size_t sequence;
+    int item;
+} HandoffSlot;
+
+// Side of a handoff queue that threads can sleep on: a futex word bumped
+// on every wake-up, the number of threads preparing to sleep or asleep,
+// and a flag saying a wake-up is wanted. The other side clears the flag
+// when it wakes somebody, so it makes one wake-up call per transition
+// rather than one per item while the woken thread is still on its way.
+typedef struct {
+    atomic_uint futex_word __attribute__((aligned(CACHE_LINE)));
+    atomic_uint sleepers;
+    atomic_bool wanted;
+} WaitPoint;
+
+// Lock-free bounded MPMC queue (per-slot sequence numbers) with adaptive
+// waiting: a thread that finds the queue full or empty spins for a while,
+// then sleeps on a futex until the other side makes progress
+typedef struct {
+    _Atomic size_t enqueue_pos __attribute__((aligned(CACHE_LINE)));
+    _Atomic size_t dequeue_pos __attribute__((aligned(CACHE_LINE)));
+    WaitPoint not_empty;
+    WaitPoint not_full;
+    HandoffSlot* slots __attribute__((aligned(CACHE_LINE)));
+    size_t mask;
+    int spin_limit;  // 0 on a single CPU, where spinning only delays the other side
+} HandoffQueue;
+
+// Function to create a handoff queue; size is rounded up to a power of two
+HandoffQueue* create_handoff_queue(size_t size) {
+    HandoffQueue* queue = (HandoffQueue*)aligned_alloc(CACHE_LINE, sizeof(HandoffQueue));
+    if (!queue) {
+        printf("Failed to allocate queue structure\n");
+        return NULL;
+    }
+    
+    // Two slots at least: with one, a full slot's sequence would match
+    // the empty mark of the next lap
+    size_t capacity = 2;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    queue->slots = (HandoffSlot*)malloc(capacity * sizeof(HandoffSlot));
+    if (!queue->slots) {
+        printf("Failed to allocate queue memory\n");
+        free(queue);
+        return NULL;
+    }
+    
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&queue->slots[i].sequence, i);
+    }
+    queue->mask = capacity - 1;
+    queue->spin_limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPIN_LIMIT : 0;
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    atomic_init(&queue->not_empty.futex_word, 0);
+    atomic_init(&queue->not_empty.sleepers, 0);
+    atomic_init(&queue->not_empty.wanted, false);
+    atomic_init(&queue->not_full.futex_word, 0);
+    atomic_init(&queue->not_full.sleepers, 0);
+    atomic_init(&queue->not_full.wanted, false);
+    
+    return queue;
+}
+
+// Function to free a handoff queue
+void free_handoff_queue(HandoffQueue* queue) {
+    if (queue) {
+        free(queue->slots);
+        free(queue);
+    }
+}
+
+// Function to try to add an item without waiting
+bool handoff_try_push(HandoffQueue* queue, int item) {
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        HandoffSlot* slot = &queue->slots[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->item = item;
+                atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;  // Full
+        } else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Function to try to take an item without waiting
+bool handoff_try_pop(HandoffQueue* queue, int* item) {
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        HandoffSlot* slot = &queue->slots[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *item = slot->item;
+                atomic_store_explicit(&slot->sequence, pos + queue->mask + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;  // Empty
+        } else {
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Function to pause briefly inside a spin loop
+void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Function to wake one sleeper after making progress on its behalf. The
+// seq_cst fence pairs with the one in wait_point_prepare: either the
+// flag is seen here, or the sleeper's last retry sees the progress.
+void wait_point_signal(WaitPoint* point) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&point->wanted, memory_order_relaxed) &&
+        atomic_exchange_explicit(&point->wanted, false, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&point->futex_word, 1, memory_order_release);
+        syscall(SYS_futex, &point->futex_word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+}
+
+// Function to read the futex word and announce a sleeper. The word is
+// read first, so a signal that clears the flag afterwards also changes
+// the word and the futex wait cannot miss it.
+unsigned wait_point_prepare(WaitPoint* point) {
+    unsigned word = atomic_load_explicit(&point->futex_word, memory_order_acquire);
+    atomic_fetch_add_explicit(&point->sleepers, 1, memory_order_relaxed);
+    atomic_store_explicit(&point->wanted, true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    return word;
+}
+
+// Function to sleep until the word moves on from the prepared value
+void wait_point_sleep(WaitPoint* point, unsigned word) {
+    syscall(SYS_futex, &point->futex_word, FUTEX_WAIT_PRIVATE, word, NULL, NULL, 0);
+}
+
+// Function to leave a wait point. Only one sleeper is woken per signal,
+// so the flag is raised again for any that are still asleep.
+void wait_point_finish(WaitPoint* point) {
+    if (atomic_fetch_sub_explicit(&point->sleepers, 1, memory_order_relaxed) > 1) {
+        atomic_store_explicit(&point->wanted, true, memory_order_relaxed);
+    }
+}
+
+// Function to get the number of queued items; only a hint while other
+// threads are running
+size_t handoff_count(HandoffQueue* queue) {
+    return atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed) -
+           atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+}
+
+// Function to add an item, spinning and then sleeping while the queue is
+// full
+void handoff_push(HandoffQueue* queue, int item) {
+    bool waited = false;
+    for (int spins = 0; !handoff_try_push(queue, item); spins++) {
+        if (spins < queue->spin_limit) {
+            cpu_relax();
+            continue;
+        }
+        
+        // Announce the sleep, then retry once so a consumer that ran in
+        // between is not missed
+        unsigned word = wait_point_prepare(&queue->not_full);
+        bool pushed = handoff_try_push(queue, item);
+        if (!pushed) {
+            wait_point_sleep(&queue->not_full, word);
+        }
+        wait_point_finish(&queue->not_full);
+        waited = true;
+        if (pushed) {
+            break;
+        }
+        spins = 0;
+    }
+    
+    // A woken producer passes the wake-up on while there is still room,
+    // since several consumers may have made room for only one wake-up
+    if (waited && handoff_count(queue) <= queue->mask) {
+        wait_point_signal(&queue->not_full);
+    }
+    wait_point_signal(&queue->not_empty);
+}
+
+// Function to take an item, spinning and then sleeping while the queue is
+// empty
+int handoff_pop(HandoffQueue* queue) {
+    int item;
+    bool waited = false;
+    for (int spins = 0; !handoff_try_pop(queue, &item); spins++) {
+        if (spins < queue->spin_limit) {
+            cpu_relax();
+            continue;
+        }
+        
+        unsigned word = wait_point_prepare(&queue->not_empty);
+        bool popped = handoff_try_pop(queue, &item);
+        if (!popped) {
+            wait_point_sleep(&queue->not_empty, word);
+        }
+        wait_point_finish(&queue->not_empty);
+        waited = true;
+        if (popped) {
+            break;
+        }
+        spins = 0;
+    }
+    
+    // A woken consumer passes the wake-up on while items remain
+    if (waited && handoff_count(queue) > 0) {
+        wait_point_signal(&queue->not_empty);
+    }
+    wait_point_signal(&queue->not_full);
+    return item;
+}
+
+// Shared state of one pipeline run. Items are indices into produced_at,
+// which the producer stamps just before handing the item over.
+typedef struct {
+    HandoffQueue* queue;  // NULL runs the condvar Buffer instead
+    Buffer* buffer;
+    uint64_t* produced_at;
+    uint64_t* latencies;  // Handoff latency of every item, by consumption order
+    _Atomic size_t consumed;
+} Pipeline;
+
+// Per-thread arguments of a pipeline run
+typedef struct {
+    Pipeline* pipeline;
+    size_t first;
+    size_t count;
+} PipelineArgs;
+
+// Function to produce a range of items into the pipeline
+void* pipeline_producer(void* arg) {
+    PipelineArgs* args = (PipelineArgs*)arg;
+    Pipeline* pipeline = args->pipeline;
+    
+    for (size_t i = args->first; i < args->first + args->count; i++) {
+        pipeline->produced_at[i] = now_ns();
+        if (pipeline->queue) {
+            handoff_push(pipeline->queue, (int)i);
+        } else {
+            buffer_put(pipeline->buffer, (int)i);
+        }
+    }
+    return NULL;
+}
+
+// Function to consume a quota of items from the pipeline
+void* pipeline_consumer(void* arg) {
+    PipelineArgs* args = (PipelineArgs*)arg;
+    Pipeline* pipeline = args->pipeline;
+    
+    for (size_t i = 0; i < args->count; i++) {
+        int item = pipeline->queue ? handoff_pop(pipeline->queue) : buffer_get(pipeline->buffer);
+        uint64_t latency = now_ns() - pipeline->produced_at[item];
+        size_t slot = atomic_fetch_add_explicit(&pipeline->consumed, 1, memory_order_relaxed);
+        pipeline->latencies[slot] = latency;
+    }
+    return NULL;
+}
+
+// Function to order latency samples
+int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Function to push items through the condvar Buffer or the handoff queue
+// with the given thread counts and print throughput and latency
+void run_pipeline(bool lock_free, int producers, int consumers, size_t items, int queue_size) {
+    Pipeline pipeline;
+    pipeline.queue = lock_free ? create_handoff_queue(queue_size) : NULL;
+    pipeline.buffer = lock_free ? NULL : create_buffer(queue_size);
+    pipeline.produced_at = (uint64_t*)malloc(items * sizeof(uint64_t));
+    pipeline.latencies = (uint64_t*)malloc(items * sizeof(uint64_t));
+    pthread_t* threads = (pthread_t*)malloc((producers + consumers) * sizeof(pthread_t));
+    PipelineArgs* args = (PipelineArgs*)malloc((producers + consumers) * sizeof(PipelineArgs));
+    if ((!pipeline.queue && !pipeline.buffer) || !pipeline.produced_at || !pipeline.latencies ||
+        !threads || !args) {
+        printf("Failed to set up pipeline\n");
+        exit(1);
+    }
+    atomic_init(&pipeline.consumed, 0);
+    
+    uint64_t start = now_ns();
+    for (int i = 0; i < producers + consumers; i++) {
+        args[i].pipeline = &pipeline;
+        if (i < producers) {
+            args[i].first = items / producers * i;
+            args[i].count = items / producers;
+            pthread_create(&threads[i], NULL, pipeline_producer, &args[i]);
+        } else {
+            args[i].first = 0;
+            args[i].count = items / consumers;
+            pthread_create(&threads[i], NULL, pipeline_consumer, &args[i]);
+        }
+    }
+    for (int i = 0; i < producers + consumers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+    
+    qsort(pipeline.latencies, items, sizeof(uint64_t), compare_u64);
+    char threads_label[32];
+    snprintf(threads_label, sizeof(threads_label), "%d/%d", producers, consumers);
+    printf("%-10s %9s %14.0f %10llu %10llu %10llu %10llu %12llu\n",
+           lock_free ? "lock-free" : "condvar", threads_label, items * 1e9 / elapsed,
+           (unsigned long long)pipeline.latencies[items / 2],
+           (unsigned long long)pipeline.latencies[items * 90 / 100],
+           (unsigned long long)pipeline.latencies[items * 99 / 100],
+           (unsigned long long)pipeline.latencies[items * 999 / 1000],
+           (unsigned long long)pipeline.latencies[items - 1]);
+    
+    free(threads);
+    free(args);
+    free(pipeline.produced_at);
+    free(pipeline.latencies);
+    free_handoff_queue(pipeline.queue);
+    free_buffer(pipeline.buffer);
+}
+
+// Function to compare the condvar Buffer with the lock-free handoff queue
+int run_pipeline_benchmark(int argc, char** argv) {
+    int producers = argc > 0 ? atoi(argv[0]) : PIPELINE_DEFAULT_THREADS;
+    int consumers = argc > 1 ? atoi(argv[1]) : PIPELINE_DEFAULT_THREADS;
+    size_t items = argc > 2 ? strtoull(argv[2], NULL, 10) : PIPELINE_DEFAULT_ITEMS;
+    int queue_size = argc > 3 ? atoi(argv[3]) : PIPELINE_DEFAULT_QUEUE;
+    if (producers < 1 || producers > PIPELINE_MAX_THREADS || consumers < 1 ||
+        consumers > PIPELINE_MAX_THREADS || queue_size < 1 || items > INT32_MAX) {
+        printf("Usage: pipeline [producers 1-%d] [consumers 1-%d] [items] [queue size]\n",
+               PIPELINE_MAX_THREADS, PIPELINE_MAX_THREADS);
+        return 1;
+    }
+    
+    // Every producer and every consumer moves the same number of items
+    items -= items % ((size_t)producers * consumers);
+    if (items == 0) {
+        printf("Need at least %d items\n", producers * consumers);
+        return 1;
+    }
+    
+    printf("%-10s %9s %14s %10s %10s %10s %10s %12s\n", "queue", "P/C", "items/s",
+           "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+    run_pipeline(false, producers, consumers, items, queue_size);
+    run_pipeline(true, producers, consumers, items, queue_size);
+    return 0;
+}
+
+// Per-thread arguments of the batch benchmark
+typedef struct {
+    Buffer* buffer;
+    size_t count;
+    int batch;  // Items a consumer drains per lock acquisition
+    uint64_t elapsed_ns;
+} BatchArgs;
+
+// Function to put a number of items into the buffer
+void* batch_producer(void* arg) {
+    BatchArgs* args = (BatchArgs*)arg;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < args->count; i++) {
+        buffer_put(args->buffer, (int)i);
+    }
+    args->elapsed_ns = now_ns() - start;
+    return NULL;
+}
+
+// Function to drain a number of items from the buffer in batches
+void* batch_consumer(void* arg) {
+    BatchArgs* args = (BatchArgs*)arg;
+    int items[BATCH_MAX];
+    uint64_t start = now_ns();
+    for (size_t done = 0; done < args->count; ) {
+        size_t left = args->count - done;
+        done += buffer_get_batch(args->buffer, items, left < (size_t)args->batch ? (int)left : args->batch);
+    }
+    args->elapsed_ns = now_ns() - start;
+    return NULL;
+}
+
+// Function to move items through one Buffer with consumers draining up to
+// batch items per lock acquisition, then print throughput, per-thread
+// rates and the buffer's backpressure counters
+void run_batch(int producers, int consumers, size_t items, int batch, int buffer_size) {
+    Buffer* buffer = create_buffer(buffer_size);
+    pthread_t* threads = (pthread_t*)malloc((producers + consumers) * sizeof(pthread_t));
+    BatchArgs* args = (BatchArgs*)malloc((producers + consumers) * sizeof(BatchArgs));
+    if (!buffer || !threads || !args) {
+        printf("Failed to set up batch run\n");
+        exit(1);
+    }
+    
+    uint64_t start = now_ns();
+    for (int i = 0; i < producers + consumers; i++) {
+        args[i].buffer = buffer;
+        args[i].batch = batch;
+        args[i].count = i < producers ? items / producers : items / consumers;
+        pthread_create(&threads[i], NULL, i < producers ? batch_producer : batch_consumer, &args[i]);
+    }
+    for (int i = 0; i < producers + consumers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+    
+    printf("\nBatch %d: %zu items in %.1f ms (%.0f items/s)\n", batch, items, elapsed / 1e6,
+           items * 1e9 / elapsed);
+    for (int i = 0; i < producers + consumers; i++) {
+        print_thread_throughput(i < producers ? "  Producer" : "  Consumer",
+                                i < producers ? i : i - producers, args[i].count,
+                                args[i].elapsed_ns);
+    }
+    print_buffer_stats(buffer);
+    
+    free(threads);
+    free(args);
+    free_buffer(buffer);
+}
+
+// Function to compare draining one item per lock acquisition with
+// draining batches
+int run_batch_benchmark(int argc, char** argv) {
+    int producers = argc > 0 ? atoi(argv[0]) : PIPELINE_DEFAULT_THREADS;
+    int consumers = argc > 1 ? atoi(argv[1]) : PIPELINE_DEFAULT_THREADS;
+    size_t items = argc > 2 ? strtoull(argv[2], NULL, 10) : PIPELINE_DEFAULT_ITEMS;
+    int batch = argc > 3 ? atoi(argv[3]) : BATCH_DEFAULT_SIZE;
+    int buffer_size = argc > 4 ? atoi(argv[4]) : BATCH_DEFAULT_BUFFER;
+    if (producers < 1 || producers > PIPELINE_MAX_THREADS || consumers < 1 ||
+        consumers > PIPELINE_MAX_THREADS || batch < 1 || batch > BATCH_MAX ||
+        buffer_size < 1 || items > INT32_MAX) {
+        printf("Usage: batch [producers 1-%d] [consumers 1-%d] [items] [batch 1-%d] [buffer size]\n",
+               PIPELINE_MAX_THREADS, PIPELINE_MAX_THREADS, BATCH_MAX);
+        return 1;
+    }
+    
+    // Every producer and every consumer moves the same number of items
+    items -= items % ((size_t)producers * consumers);
+    if (items == 0) {
+        printf("Need at least %d items\n", producers * consumers);
+        return 1;
+    }
+    
+    run_batch(producers, consumers, items, 1, buffer_size);
+    if (batch > 1) {
+        run_batch(producers, consumers, items, batch, buffer_size);
+    }
+    return 0;
+}
+
+// Function to advance a xorshift64 generator
+uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Task run by the work-stealing executor
+typedef void (*TaskFunction)(void* arg);
+
+typedef struct Task {
+    TaskFunction function;
+    void* arg;
+    struct Task* next;  // Link in the executor's inbox
+} Task;
+
+// Circular array behind a work deque. An array replaced by a larger one
+// stays allocated until the deque is freed, since a thief may still be
+// reading from it.
+typedef struct DequeArray {
+    long size;  // Power of two
+    struct DequeArray* retired;  // Array this one replaced
+    _Atomic(Task*) tasks[];
+} DequeArray;
+
+// Chase-Lev work deque. The owner pushes and takes at the bottom without
+// atomic read-modify-writes except for the last task; thieves take from
+// the top with a CAS.
+typedef struct {
+    atomic_long top __attribute__((aligned(CACHE_LINE)));
+    atomic_long bottom __attribute__((aligned(CACHE_LINE)));
+    _Atomic(DequeArray*) array;
+} WorkDeque;
+
+typedef struct Executor Executor;
+
+// Worker thread of the executor and the deque it owns
+typedef struct {
+    WorkDeque deque;
+    Executor* executor;
+    int id;
+    uint64_t random_state;  // Victim selection
+    size_t executed;
+    size_t steals;
+    pthread_t thread;
+} Worker;
+
+// Work-stealing executor. Tasks submitted by a worker go to the bottom of
+// its own deque; tasks submitted from other threads go to a locked inbox
+// that any idle worker drains.
+struct Executor {
+    Worker* workers;
+    int num_workers;
+    int spin_limit;
+    pthread_mutex_t inbox_mutex;
+    Task* inbox_head;
+    Task* inbox_tail;
+    atomic_size_t inbox_count;  // Lets idle workers skip the lock
+    atomic_size_t pending;  // Submitted tasks that have not finished
+    atomic_bool stopping;
+    WaitPoint work_available;
+    WaitPoint all_done;
+};
+
+// Worker running on the current thread, NULL outside the executor
+__thread Worker* current_worker = NULL;
+
+// Function to allocate a deque array
+DequeArray* create_deque_array(long size, DequeArray* retired) {
+    DequeArray* array = (DequeArray*)malloc(sizeof(DequeArray) + size * sizeof(_Atomic(Task*)));
+    if (!array) {
+        printf("Failed to allocate deque memory\n");
+        exit(1);
+    }
+    array->size = size;
+    array->retired = retired;
+    return array;
+}
+
+// Function to initialize an empty deque
+void init_work_deque(WorkDeque* deque) {
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, create_deque_array(DEQUE_INITIAL_SIZE, NULL));
+}
+
+// Function to free a deque's current and retired arrays
+void free_work_deque(WorkDeque* deque) {
+    DequeArray* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    while (array) {
+        DequeArray* retired = array->retired;
+        free(array);
+        array = retired;
+    }
+}
+
+// Function to push a task at the bottom; owner only
+void deque_push(WorkDeque* deque, Task* task) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    DequeArray* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    
+    if (bottom - top >= array->size) {
+        // Full: copy the live range into an array twice the size
+        DequeArray* larger = create_deque_array(array->size * 2, array);
+        for (long i = top; i < bottom; i++) {
+            Task* moved = atomic_load_explicit(&array->tasks[i & (array->size - 1)],
+                                               memory_order_relaxed);
+            atomic_store_explicit(&larger->tasks[i & (larger->size - 1)], moved,
+                                  memory_order_relaxed);
+        }
+        atomic_store_explicit(&deque->array, larger, memory_order_release);
+        array = larger;
+    }
+    
+    atomic_store_explicit(&array->tasks[bottom & (array->size - 1)], task, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+}
+
+// Function to take the most recently pushed task; owner only. Returns NULL
+// when the deque is empty or a thief won the last task.
+Task* deque_take(WorkDeque* deque) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    DequeArray* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_release);
+    
+    // Claiming the slot must be visible before top is read, or the owner
+    // and a thief could both take the last task
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+        return NULL;
+    }
+    
+    Task* task = atomic_load_explicit(&array->tasks[bottom & (array->size - 1)],
+                                      memory_order_relaxed);
+    if (top == bottom) {
+        // Last task: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+    }
+    return task;
+}
+
+// Function to steal the oldest task. Returns NULL when the deque is empty
+// and DEQUE_ABORT when another thread took the task first.
+Task* deque_steal(WorkDeque* deque) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return NULL;
+    }
+    
+    DequeArray* array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    Task* task = atomic_load_explicit(&array->tasks[top & (array->size - 1)],
+                                      memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return DEQUE_ABORT;
+    }
+    return task;
+}
+
+// Function to get whether a deque looks non-empty
+bool deque_has_tasks(WorkDeque* deque) {
+    return atomic_load_explicit(&deque->bottom, memory_order_relaxed) >
+           atomic_load_explicit(&deque->top, memory_order_relaxed);
+}
+
+// Function to take a task from the executor's inbox
+Task* executor_take_inbox(Executor* executor) {
+    if (atomic_load_explicit(&executor->inbox_count, memory_order_relaxed) == 0) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&executor->inbox_mutex);
+    Task* task = executor->inbox_head;
+    if (task) {
+        executor->inbox_head = task->next;
+        if (!executor->inbox_head) {
+            executor->inbox_tail = NULL;
+        }
+        atomic_fetch_sub_explicit(&executor->inbox_count, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&executor->inbox_mutex);
+    return task;
+}
+
+// Function to find work for a worker: its own deque first, then the
+// inbox, then the other workers' deques starting from a random victim
+Task* executor_find_task(Worker* worker) {
+    Executor* executor = worker->executor;
+    Task* task = deque_take(&worker->deque);
+    if (task) {
+        return task;
+    }
+    
+    task = executor_take_inbox(executor);
+    if (task) {
+        return task;
+    }
+    
+    int start = next_random(&worker->random_state) % executor->num_workers;
+    for (int i = 0; i < executor->num_workers; i++) {
+        Worker* victim = &executor->workers[(start + i) % executor->num_workers];
+        if (victim == worker) {
+            continue;
+        }
+        do {
+            task = deque_steal(&victim->deque);
+        } while (task == DEQUE_ABORT);
+        if (task) {
+            worker->steals++;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+// Function to check for queued work without taking it
+bool executor_has_work(Executor* executor) {
+    if (atomic_load_explicit(&executor->inbox_count, memory_order_relaxed) > 0) {
+        return true;
+    }
+    for (int i = 0; i < executor->num_workers; i++) {
+        if (deque_has_tasks(&executor->workers[i].deque)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to run a task and account for its completion
+void executor_run_task(Worker* worker, Task* task) {
+    Executor* executor = worker->executor;
+    task->function(task->arg);
+    free(task);
+    worker->executed++;
+    
+    if (atomic_fetch_sub_explicit(&executor->pending, 1, memory_order_acq_rel) == 1) {
+        wait_point_signal(&executor->all_done);
+    }
+}
+
+// Function run by each worker thread until the executor stops
+void* executor_worker(void* arg) {
+    Worker* worker = (Worker*)arg;
+    Executor* executor = worker->executor;
+    current_worker = worker;
+    
+    bool woken = false;
+    int spins = 0;
+    for (;;) {
+        Task* task = executor_find_task(worker);
+        if (task) {
+            // Only one worker is woken per wake-up, though many tasks may
+            // have been queued since; a woken worker that found work
+            // passes the wake-up on
+            if (woken) {
+                wait_point_signal(&executor->work_available);
+                woken = false;
+            }
+            executor_run_task(worker, task);
+            spins = 0;
+            continue;
+        }
+        
+        if (atomic_load_explicit(&executor->stopping, memory_order_relaxed)) {
+            break;
+        }
+        if (spins < executor->spin_limit) {
+            spins++;
+            cpu_relax();
+            continue;
+        }
+        
+        // Announce the sleep, then look once more so a submit that ran in
+        // between is not missed
+        unsigned word = wait_point_prepare(&executor->work_available);
+        if (!atomic_load_explicit(&executor->stopping, memory_order_relaxed) &&
+            !executor_has_work(executor)) {
+            wait_point_sleep(&executor->work_available, word);
+        }
+        wait_point_finish(&executor->work_available);
+        woken = true;
+        spins = 0;
+    }
+    
+    // Pass the stop on to the next sleeper
+    wait_point_signal(&executor->work_available);
+    return NULL;
+}
+
+// Function to create an executor and start its workers
+Executor* create_executor(int num_workers) {
+    Executor* executor = (Executor*)aligned_alloc(CACHE_LINE, sizeof(Executor));
+    if (!executor) {
+        printf("Failed to allocate executor structure\n");
+        return NULL;
+    }
+    
+    executor->workers = (Worker*)aligned_alloc(CACHE_LINE, num_workers * sizeof(Worker));
+    if (!executor->workers) {
+        printf("Failed to allocate workers\n");
+        free(executor);
+        return NULL;
+    }
+    
+    executor->num_workers = num_workers;
+    executor->spin_limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPIN_LIMIT : 0;
+    pthread_mutex_init(&executor->inbox_mutex, NULL);
+    executor->inbox_head = NULL;
+    executor->inbox_tail = NULL;
+    atomic_init(&executor->inbox_count, 0);
+    atomic_init(&executor->pending, 0);
+    atomic_init(&executor->stopping, false);
+    atomic_init(&executor->work_available.futex_word, 0);
+    atomic_init(&executor->work_available.sleepers, 0);
+    atomic_init(&executor->work_available.wanted, false);
+    atomic_init(&executor->all_done.futex_word, 0);
+    atomic_init(&executor->all_done.sleepers, 0);
+    atomic_init(&executor->all_done.wanted, false);
+    
+    for (int i = 0; i < num_workers; i++) {
+        Worker* worker = &executor->workers[i];
+        init_work_deque(&worker->deque);
+        worker->executor = executor;
+        worker->id = i;
+        worker->random_state = 0x9E3779B97F4A7C15ULL * (i + 1);
+        worker->executed = 0;
+        worker->steals = 0;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        pthread_create(&executor->workers[i].thread, NULL, executor_worker, &executor->workers[i]);
+    }
+    
+    return executor;
+}
+
+// Function to submit a task. From a worker the task goes to the bottom
+// of its own deque, where it runs next unless another worker steals it.
+void executor_submit(Executor* executor, TaskFunction function, void* arg) {
+    Task* task = (Task*)malloc(sizeof(Task));
+    if (!task) {
+        printf("Failed to allocate task\n");
+        exit(1);
+    }
+    task->function = function;
+    task->arg = arg;
+    task->next = NULL;
+    atomic_fetch_add_explicit(&executor->pending, 1, memory_order_relaxed);
+    
+    if (current_worker && current_worker->executor == executor) {
+        deque_push(&current_worker->deque, task);
+    } else {
+        pthread_mutex_lock(&executor->inbox_mutex);
+        if (executor->inbox_tail) {
+            executor->inbox_tail->next = task;
+        } else {
+            executor->inbox_head = task;
+        }
+        executor->inbox_tail = task;
+        atomic_fetch_add_explicit(&executor->inbox_count, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&executor->inbox_mutex);
+    }
+    wait_point_signal(&executor->work_available);
+}
+
+// Function to wait until every submitted task, including tasks submitted
+// by other tasks, has finished. Must not be called from a task.
+void executor_wait(Executor* executor) {
+    while (atomic_load_explicit(&executor->pending, memory_order_acquire) != 0) {
+        unsigned word = wait_point_prepare(&executor->all_done);
+        if (atomic_load_explicit(&executor->pending, memory_order_acquire) != 0) {
+            wait_point_sleep(&executor->all_done, word);
+        }
+        wait_point_finish(&executor->all_done);
+    }
+}
+
+// Function to get the index of the worker running the calling task, or -1
+// outside the executor
+int executor_worker_id() {
+    return current_worker ? current_worker->id : -1;
+}
+
+// Function to stop the workers and free the executor. Call executor_wait
+// first; the workers stop as soon as they find no work.
+void free_executor(Executor* executor) {
+    if (!executor) {
+        return;
+    }
+    
+    atomic_store(&executor->stopping, true);
+    wait_point_signal(&executor->work_available);
+    for (int i = 0; i < executor->num_workers; i++) {
+        pthread_join(executor->workers[i].thread, NULL);
+        free_work_deque(&executor->workers[i].deque);
+    }
+    
+    while (executor->inbox_head) {
+        Task* next = executor->inbox_head->next;
+        free(executor->inbox_head);
+        executor->inbox_head = next;
+    }
+    pthread_mutex_destroy(&executor->inbox_mutex);
+    free(executor->workers);
+    free(executor);
+}
+
+// Work each scheduling benchmark design ended up doing per worker, padded
+// so workers do not share counter lines
+typedef struct {
+    uint64_t units __attribute__((aligned(CACHE_LINE)));
+    uint64_t finished_at;  // End of the worker's last task
+} WorkerLoad;
+
+// Shared state of a scheduling benchmark: the cost of every task in work
+// units and the load each worker ended up with
+typedef struct {
+    uint32_t* costs;
+    uint64_t* results;
+    size_t tasks;
+    int workers;
+    Buffer* buffer;
+    Executor* executor;
+    struct StealItem* items;
+    WorkerLoad loads[STEAL_MAX_WORKERS];
+} StealBench;
+
+// Per-thread arguments of the buffer designs
+typedef struct {
+    StealBench* bench;
+    int id;
+    size_t quota;  // 0 takes tasks until a negative index arrives
+} StealConsumerArgs;
+
+// Range of tasks a stealing design partition submits
+typedef struct {
+    StealBench* bench;
+    size_t first;
+    size_t count;
+} StealPartition;
+
+// Leaf task of the stealing design
+typedef struct StealItem {
+    StealBench* bench;
+    size_t index;
+} StealItem;
+
+// Function to burn the CPU for a number of work units
+uint64_t burn_units(uint32_t units) {
+    uint64_t x = units | 1;
+    for (uint64_t i = 0; i < (uint64_t)units * STEAL_UNIT_ITERATIONS; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    return x;
+}
+
+// Function to run one benchmark task on behalf of a worker
+void steal_bench_run(StealBench* bench, size_t index, int worker) {
+    bench->results[index] = burn_units(bench->costs[index]);
+    bench->loads[worker].units += bench->costs[index];
+    bench->loads[worker].finished_at = now_ns();
+}
+
+// Function to consume tasks from the shared buffer
+void* steal_bench_consumer(void* arg) {
+    StealConsumerArgs* args = (StealConsumerArgs*)arg;
+    StealBench* bench = args->bench;
+    
+    for (size_t done = 0; args->quota == 0 || done < args->quota; done++) {
+        int index = buffer_get(bench->buffer);
+        if (index < 0) {
+            break;
+        }
+        steal_bench_run(bench, index, args->id);
+    }
+    return NULL;
+}
+
+// Function run as a leaf task of the stealing design
+void steal_bench_item(void* arg) {
+    StealItem* item = (StealItem*)arg;
+    steal_bench_run(item->bench, item->index, executor_worker_id());
+}
+
+// Function run as a partition task of the stealing design: it submits its
+// range to the running worker's own deque, as a consumer's quota would be
+void steal_bench_partition(void* arg) {
+    StealPartition* partition = (StealPartition*)arg;
+    StealBench* bench = partition->bench;
+    for (size_t i = partition->first; i < partition->first + partition->count; i++) {
+        executor_submit(bench->executor, steal_bench_item, &bench->items[i]);
+    }
+}
+
+// Function to print one design's balance: the spread of work units over
+// the workers and how long the first idle worker waited for the last
+void print_steal_result(const char* design, StealBench* bench, uint64_t elapsed, long steals) {
+    uint64_t total = 0, min_units = UINT64_MAX, max_units = 0;
+    uint64_t first_done = UINT64_MAX, last_done = 0;
+    for (int i = 0; i < bench->workers; i++) {
+        WorkerLoad* load = &bench->loads[i];
+        total += load->units;
+        min_units = load->units < min_units ? load->units : min_units;
+        max_units = load->units > max_units ? load->units : max_units;
+        first_done = load->finished_at < first_done ? load->finished_at : first_done;
+        last_done = load->finished_at > last_done ? load->finished_at : last_done;
+    }
+    
+    char steals_label[32] = "-";
+    if (steals >= 0) {
+        snprintf(steals_label, sizeof(steals_label), "%ld", steals);
+    }
+    printf("%-14s %10.1f %12.0f %10llu %10llu %10.2f %10.2f %10s\n", design, elapsed / 1e6,
+           bench->tasks * 1e9 / elapsed, (unsigned long long)min_units,
+           (unsigned long long)max_units, max_units * (double)bench->workers / total,
+           (last_done - first_done) / 1e6, steals_label);
+}
+
+// Function to clear the per-worker loads before a design runs
+void reset_steal_loads(StealBench* bench) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < bench->workers; i++) {
+        bench->loads[i].units = 0;
+        bench->loads[i].finished_at = start;
+    }
+}
+
+// Function to run the producer/consumer design: the calling thread feeds
+// task indices through one shared Buffer. With quotas every consumer takes
+// the same number of tasks, as the demo's consumers do; without, each
+// takes tasks until it reads a stop marker.
+void run_buffer_design(StealBench* bench, bool quotas) {
+    pthread_t threads[STEAL_MAX_WORKERS];
+    StealConsumerArgs args[STEAL_MAX_WORKERS];
+    bench->buffer = create_buffer(STEAL_BUFFER_SIZE);
+    if (!bench->buffer) {
+        exit(1);
+    }
+    reset_steal_loads(bench);
+    
+    uint64_t start = now_ns();
+    for (int i = 0; i < bench->workers; i++) {
+        args[i].bench = bench;
+        args[i].id = i;
+        args[i].quota = quotas ? bench->tasks / bench->workers : 0;
+        pthread_create(&threads[i], NULL, steal_bench_consumer, &args[i]);
+    }
+    for (size_t i = 0; i < bench->tasks; i++) {
+        buffer_put(bench->buffer, (int)i);
+    }
+    if (!quotas) {
+        for (int i = 0; i < bench->workers; i++) {
+            buffer_put(bench->buffer, -1);
+        }
+    }
+    for (int i = 0; i < bench->workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+    
+    print_steal_result(quotas ? "buffer quota" : "buffer shared", bench, elapsed, -1);
+    free_buffer(bench->buffer);
+    bench->buffer = NULL;
+}
+
+// Function to run the work-stealing design: the tasks are cut into one
+// equal partition per worker and submitted through the executor's shared
+// inbox. Whichever worker picks a partition up pushes its tasks onto its
+// own deque, so one worker may start with several partitions; idle workers
+// steal from the others.
+void run_stealing_design(StealBench* bench) {
+    StealPartition partitions[STEAL_MAX_WORKERS];
+    bench->executor = create_executor(bench->workers);
+    if (!bench->executor) {
+        exit(1);
+    }
+    reset_steal_loads(bench);
+    
+    uint64_t start = now_ns();
+    size_t share = bench->tasks / bench->workers;
+    for (int i = 0; i < bench->workers; i++) {
+        partitions[i].bench = bench;
+        partitions[i].first = share * i;
+        partitions[i].count = share;
+        executor_submit(bench->executor, steal_bench_partition, &partitions[i]);
+    }
+    executor_wait(bench->executor);
+    uint64_t elapsed = now_ns() - start;
+    
+    long steals = 0;
+    for (int i = 0; i < bench->workers; i++) {
+        steals += bench->executor->workers[i].steals;
+    }
+    print_steal_result("stealing", bench, elapsed, steals);
+    free_executor(bench->executor);
+    bench->executor = NULL;
+}
+
+// Function to compare how evenly the shared Buffer and the work-stealing
+// executor spread tasks whose costs follow a heavy tail: a task costs
+// 2^k units with probability 2^-(k+1), so every cost class carries about
+// the same share of the total work
+int run_steal_benchmark(int argc, char** argv) {
+    StealBench bench;
+    bench.workers = argc > 0 ? atoi(argv[0]) : STEAL_DEFAULT_WORKERS;
+    bench.tasks = argc > 1 ? strtoull(argv[1], NULL, 10) : STEAL_DEFAULT_TASKS;
+    if (bench.workers < 1 || bench.workers > STEAL_MAX_WORKERS || bench.tasks > INT32_MAX) {
+        printf("Usage: steal [workers 1-%d] [tasks]\n", STEAL_MAX_WORKERS);
+        return 1;
+    }
+    
+    // Every partition holds the same number of tasks
+    bench.tasks -= bench.tasks % bench.workers;
+    if (bench.tasks == 0) {
+        printf("Need at least %d tasks\n", bench.workers);
+        return 1;
+    }
+    
+    bench.costs = (uint32_t*)malloc(bench.tasks * sizeof(uint32_t));
+    bench.results = (uint64_t*)malloc(bench.tasks * sizeof(uint64_t));
+    bench.items = (StealItem*)malloc(bench.tasks * sizeof(StealItem));
+    if (!bench.costs || !bench.results || !bench.items) {
+        printf("Failed to allocate tasks\n");
+        free(bench.costs);
+        free(bench.results);
+        free(bench.items);
+        return 1;
+    }
+    
+    uint64_t random_state = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0; i < bench.tasks; i++) {
+        uint64_t bits = next_random(&random_state) | (1ULL << STEAL_MAX_COST_SHIFT);
+        bench.costs[i] = 1u << __builtin_ctzll(bits);
+        bench.items[i].bench = &bench;
+        bench.items[i].index = i;
+    }
+    
+    printf("%-14s %10s %12s %10s %10s %10s %10s %10s\n", "design", "wall ms", "tasks/s",
+           "min units", "max units", "imbalance", "idle ms", "steals");
+    run_buffer_design(&bench, true);
+    run_buffer_design(&bench, false);
+    run_stealing_design(&bench);
+    
+    free(bench.costs);
+    free(bench.results);
+    free(bench.items);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // "pipeline [producers] [consumers] [items] [queue size]" measures
+    // handoff throughput and latency without the demo's printing and sleeps
+    if (argc > 1 && strcmp(argv[1], "pipeline") == 0) {
+        return run_pipeline_benchmark(argc - 2, argv + 2);
+    }
+    
+    // "batch [producers] [consumers] [items] [batch] [buffer size]" compares
+    // per-item and batched drains and prints the backpressure counters
+    if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+        return run_batch_benchmark(argc - 2, argv + 2);
+    }
+    
+    // "steal [workers] [tasks]" compares load balance of the shared Buffer
+    // and the work-stealing executor under skewed task costs
+    if (argc > 1 && strcmp(argv[1], "steal") == 0) {
+        return run_steal_benchmark(argc - 2, argv + 2);
+    }
+    
     // Initialize random seed
     srand(time(NULL));
     
@@ -185,6 +1556,15 @@ int main() {
         pthread_join(consumers[i], NULL);
     }
     
+    // Report per-thread throughput and backpressure
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        print_thread_throughput("Producer", i, producer_args[i].num_items, producer_args[i].elapsed_ns);
+    }
+    for (int i = 0; i < NUM_CONSUMERS; i++) {
+        print_thread_throughput("Consumer", i, consumer_args[i].num_items, consumer_args[i].elapsed_ns);
+    }
+    print_buffer_stats(buffer);
+    
     // Clean up
     free_buffer(buffer);
     
@@ -1,110 +1,1686 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <stdatomic.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#include <linux/io_uring.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
-#define MAX_CLIENTS 5
+#define LISTEN_BACKLOG 4096
+#define MAX_EVENTS 1024  // Readiness events taken per epoll_wait
+#define MAX_REACTORS 256
+#define CACHE_LINE 64
 
-// Global variables for cleanup
-int server_fd = -1;
-int client_sockets[MAX_CLIENTS] = {-1};
+// Admin endpoint, reachable from this machine only
+#define ADMIN_PORT 8081
+#define ADMIN_RECV_TIMEOUT_MS 100  // How long to wait for a request before replying anyway
 
-// Signal handler for graceful shutdown
-void handle_signal(int sig) {
-    printf("\nReceived signal %d, cleaning up...\n", sig);
+// Latency histogram: values up to 2^HISTOGRAM_MAX_BITS ns, each power of
+// two split into 2^HISTOGRAM_SUB_BITS buckets
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+// Framed protocol: a 4-byte big-endian payload length, then the payload.
+// A reply is framed the same way and carries the request's payload back.
+#define FRAME_HEADER_SIZE 4
+#define FRAME_MAX_PAYLOAD (64 * 1024)  // Larger frames end the connection
+#define FRAME_BATCH 512  // Replies per sendmsg, two iovecs each, within IOV_MAX
+#define FRAME_RECV_SIZE (16 * 1024)  // Bytes read per recv by the epoll loop
+
+// Payload protocols: a bare 4-byte request names a body size, and the
+// reply is a 4-byte length followed by that many bytes of a static payload
+#define PAYLOAD_MAX (16 * 1024 * 1024)
+
+// Wire protocols, indexing protocol_names
+#define PROTOCOL_RAW 0
+#define PROTOCOL_FRAMED 1
+#define PROTOCOL_COPY 2  // Payload copied from a heap buffer by send
+#define PROTOCOL_FILE 3  // Payload sent from a file by sendfile
+#define PROTOCOL_ZEROCOPY 4  // Payload sent from a heap buffer with MSG_ZEROCOPY
+#define PROTOCOL_COUNT 5
+
+// Zero-copy benchmark parameters
+#define ZEROCOPY_DEFAULT_SECONDS 1  // Per payload size and protocol
+#define ZEROCOPY_MIN_SIZE 1024
+#define ZEROCOPY_RECV_SIZE (256 * 1024)
+
+// Scaling benchmark parameters
+#define BENCH_DEFAULT_SECONDS 3
+#define BENCH_CLIENTS 64  // Blocking client threads, the same for every reactor count
+
+// io_uring backend parameters
+#define URING_ENTRIES 4096  // Submission queue entries
+#define URING_CQ_ENTRIES 16384
+#define URING_BUFFERS 4096  // Provided receive buffers of BUFFER_SIZE bytes, power of two
+#define URING_BUFFER_GROUP 0
+#define URING_MAX_QUEUED (1 << 20)  // Unsent response bytes before a client is dropped
+
+// Operation tags in the low bits of io_uring user_data, which otherwise
+// holds the connection
+#define URING_OP_ACCEPT 0
+#define URING_OP_RECV 1
+#define URING_OP_SEND 2
+#define URING_OP_WAKE 3
+#define URING_OP_MASK 3
+
+// Streaming state of the framed protocol: the start of a frame that a read
+// ended in the middle of, completed by the next reads
+typedef struct {
+    char* partial;
+    size_t partial_length;
+    size_t partial_capacity;
+} FrameParser;
+
+// Replies to the frames parsed from one read, sent with one vectored
+// write. Each reply is its length header followed by the payload, which
+// still lies in the receive buffer (or the parser's partial frame).
+typedef struct {
+    uint32_t headers[FRAME_BATCH];
+    struct iovec iov[2 * FRAME_BATCH];
+    int frames;
+    bool holds_partial;  // A reply points into the parser's partial frame
+} FrameBatch;
+
+// State of one client connection in the event loop
+typedef struct Connection {
+    int fd;
+    bool read_paused;  // Input left unread until pending output drains
+    FrameParser parser;  // Also holds unanswered payload requests
+    size_t body_offset;  // Progress through the payload reply being sent
+    size_t body_length;
+    uint64_t body_started;
+    int zerocopy_inflight;  // MSG_ZEROCOPY sends whose pages the kernel holds
+    char* pending;  // Response bytes the socket would not take yet
+    size_t pending_length;
+    size_t pending_offset;
+    struct Connection* prev;
+    struct Connection* next;
+} Connection;
+
+// Single-threaded event loop over edge-triggered epoll. Connections are
+// kept on a list so shutdown can close them all.
+typedef struct {
+    int epoll_fd;
+    int listen_fd;
+    int spare_fd;  // Given up to shed a connection when out of descriptors
+    int wake_fd;
+    atomic_bool* stopping;
+    Connection* connections;
+    size_t active;
+} EventLoop;
+
+// Submission and completion rings of an io_uring instance, mapped from
+// the kernel, and the provided buffer ring that multishot receives fill
+typedef struct {
+    int fd;
+    unsigned sq_entries;
+    unsigned sq_mask;
+    _Atomic unsigned* sq_head;
+    _Atomic unsigned* sq_tail;
+    unsigned sq_local_tail;  // Entries filled; published on submit
+    struct io_uring_sqe* sqes;
+    unsigned cq_mask;
+    _Atomic unsigned* cq_head;
+    _Atomic unsigned* cq_tail;
+    struct io_uring_cqe* cqes;
+    void* rings;  // Both rings, mapped at once
+    size_t rings_size;
+    size_t sqes_size;
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    unsigned short buf_tail;
+    char* buffers;
+} Uring;
+
+// Client connection served by the io_uring backend. Only one send is in
+// flight at a time; responses produced meanwhile collect in the queue
+// buffer and go out together when it completes.
+typedef struct UringConnection {
+    int fd;
+    int inflight;  // Operations the kernel still holds for this connection
+    bool closing;
+    bool shut_down;
+    FrameParser parser;
+    char* send_buffer;
+    size_t send_capacity;
+    size_t send_length;
+    size_t send_offset;
+    char* queue_buffer;
+    size_t queue_capacity;
+    size_t queue_length;
+    struct UringConnection* prev;
+    struct UringConnection* next;
+} UringConnection;
+
+// Single-threaded server driven by io_uring completions
+typedef struct {
+    Uring ring;
+    int listen_fd;
+    int spare_fd;  // Given up to shed a connection when out of descriptors
+    int wake_fd;
+    atomic_bool* stopping;
+    UringConnection* connections;
+    size_t active;
+    bool accepted;  // A multishot accept has worked on this kernel
+    bool unsupported;
+} UringServer;
+
+// Log-linear latency histogram in the manner of HdrHistogram: a bucket is
+// 1/32 of its power of two wide, so any percentile read from it is within
+// about 3% of the true value
+typedef struct {
+    _Atomic uint64_t buckets[HISTOGRAM_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t total_ns;
+    _Atomic uint64_t max_ns;
+} LatencyHistogram;
+
+// Counters of one reactor. Only the reactor's thread writes them, so an
+// update is a relaxed load and store rather than a locked instruction;
+// being atomic, they can still be read live by the admin endpoint.
+typedef struct {
+    _Atomic uint64_t requests;
+    _Atomic uint64_t syscalls;
+    _Atomic uint64_t accepts;
+    _Atomic uint64_t active_connections;
+    _Atomic uint64_t bytes_in;
+    _Atomic uint64_t bytes_out;
+    _Atomic uint64_t zerocopy_sends;
+    _Atomic uint64_t zerocopy_copied;  // Sends the kernel copied after all
+    // From reading a request to handing its reply on: to send() in the
+    // epoll loop, to the send or queue buffer with io_uring, where the
+    // send completes later
+    LatencyHistogram latency;
+} __attribute__((aligned(CACHE_LINE))) ServerStats;
+
+// Reactor thread: its own SO_REUSEPORT listener on PORT and its own event
+// loop, so the kernel spreads new connections over the reactors without
+// a shared accept lock
+typedef struct {
+    int id;
+    bool use_uring;
+    atomic_bool fell_back;  // Asked for io_uring but ran epoll
+    int listen_fd;
+    int wake_fd;  // eventfd written to stop the loop
+    atomic_bool stopping;
+    ServerStats stats;  // Own cache lines, so reactors never share one
+    uint64_t cpu_ns;  // CPU time the thread used, set when it stops
+    pthread_t thread;
+} Reactor;
+
+// Admin endpoint: a loopback listener served by its own thread, so a slow
+// reader never holds up a reactor
+typedef struct {
+    int listen_fd;
+    Reactor* reactors;
+    int count;
+    pthread_t thread;
+} AdminEndpoint;
+
+// Counters of the reactor running on the current thread
+__thread ServerStats* server_stats;
+
+// Whether connections are logged; the benchmarks turn it off. Requests
+// are only counted, since a printf each would cap the request rate.
+bool log_traffic = true;
+
+// Protocol spoken to every client
+const char* protocol_names[PROTOCOL_COUNT] = { "raw", "framed", "copy", "file", "zerocopy" };
+int protocol = PROTOCOL_RAW;
+
+// Static payload of the payload protocols, shared read-only by the
+// reactors: in memory for copy and zerocopy, in an unlinked file for file
+char* payload_buffer = NULL;
+int payload_file = -1;
+
+// Function to read a monotonic clock in nanoseconds
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Function to add to a counter that only the calling thread writes
+void metric_add(_Atomic uint64_t* counter, uint64_t amount) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount,
+                          memory_order_relaxed);
+}
+
+// Function to set a gauge that only the calling thread writes
+void metric_set(_Atomic uint64_t* gauge, uint64_t value) {
+    atomic_store_explicit(gauge, value, memory_order_relaxed);
+}
+
+// Function to read a counter that another thread may be writing
+uint64_t metric_read(_Atomic uint64_t* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+// Function to find the histogram bucket of a latency. Values below
+// 2^(HISTOGRAM_SUB_BITS + 1) get a bucket each; above, the top
+// HISTOGRAM_SUB_BITS + 1 bits pick one.
+int histogram_bucket(uint64_t ns) {
+    if (ns >= 1ULL << HISTOGRAM_MAX_BITS) {
+        ns = (1ULL << HISTOGRAM_MAX_BITS) - 1;
+    }
+    if (ns < 2ULL << HISTOGRAM_SUB_BITS) {
+        return ns;
+    }
+    int exponent = 63 - __builtin_clzll(ns);
+    int shift = exponent - HISTOGRAM_SUB_BITS;
+    return (shift << HISTOGRAM_SUB_BITS) + (ns >> shift);
+}
+
+// Function to get the smallest latency a histogram bucket holds
+uint64_t histogram_bucket_floor(int bucket) {
+    if (bucket < 2 << HISTOGRAM_SUB_BITS) {
+        return bucket;
+    }
+    int shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t mantissa = (1 << HISTOGRAM_SUB_BITS) + (bucket & ((1 << HISTOGRAM_SUB_BITS) - 1));
+    return mantissa << shift;
+}
+
+// Function to record that count requests took ns each
+void record_latency(uint64_t ns, uint64_t count) {
+    LatencyHistogram* histogram = &server_stats->latency;
+    metric_add(&histogram->buckets[histogram_bucket(ns)], count);
+    metric_add(&histogram->count, count);
+    metric_add(&histogram->total_ns, ns * count);
+    if (ns > metric_read(&histogram->max_ns)) {
+        metric_set(&histogram->max_ns, ns);
+    }
+}
+
+// Function to raise the descriptor limit to the hard limit, since every
+// client holds one
+void raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            perror("setrlimit failed");
+        }
+    }
+}
+
+// Function to grow a byte buffer to hold at least needed bytes
+bool reserve_buffer(char** buffer, size_t* capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    size_t grown = *capacity ? *capacity : 256;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    char* resized = (char*)realloc(*buffer, grown);
+    if (!resized) {
+        return false;
+    }
+    *buffer = resized;
+    *capacity = grown;
+    return true;
+}
+
+// Function to switch a socket to non-blocking mode
+int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        perror("fcntl failed");
+        return -1;
+    }
+    return 0;
+}
+
+// Function to register a new client socket with the event loop. Read and
+// write readiness are both watched from the start: with edge triggering
+// that costs nothing until the socket's send buffer fills.
+Connection* open_connection(EventLoop* loop, int fd) {
+    Connection* conn = (Connection*)calloc(1, sizeof(Connection));
+    if (!conn) {
+        printf("Failed to allocate connection\n");
+        return NULL;
+    }
+    conn->fd = fd;
+    
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = conn;
+    metric_add(&server_stats->syscalls, 1);
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("epoll_ctl failed");
+        free(conn);
+        return NULL;
+    }
+    
+    conn->next = loop->connections;
+    if (loop->connections) {
+        loop->connections->prev = conn;
+    }
+    loop->connections = conn;
+    loop->active++;
+    metric_set(&server_stats->active_connections, loop->active);
+    return conn;
+}
+
+// Function to close a client connection and forget it
+void close_connection(EventLoop* loop, Connection* conn) {
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        loop->connections = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    loop->active--;
+    metric_set(&server_stats->active_connections, loop->active);
+    
+    // Closing the descriptor also removes it from the epoll set
+    metric_add(&server_stats->syscalls, 1);
+    close(conn->fd);
+    free(conn->pending);
+    free(conn->parser.partial);
+    free(conn);
+}
+
+// Function to send the pending output. Returns false when the connection
+// failed.
+bool flush_pending(Connection* conn) {
+    while (conn->pending_offset < conn->pending_length) {
+        metric_add(&server_stats->syscalls, 1);
+        ssize_t sent = send(conn->fd, conn->pending + conn->pending_offset,
+                            conn->pending_length - conn->pending_offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("send failed");
+            return false;
+        }
+        metric_add(&server_stats->bytes_out, sent);
+        conn->pending_offset += sent;
+    }
+    
+    free(conn->pending);
+    conn->pending = NULL;
+    conn->pending_length = 0;
+    conn->pending_offset = 0;
+    return true;
+}
+
+// Function to keep output the socket did not take, behind anything
+// already pending. Returns false when it cannot be stored.
+bool queue_output(Connection* conn, const char* data, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+    char* pending = (char*)realloc(conn->pending, conn->pending_length + length);
+    if (!pending) {
+        printf("Failed to queue response\n");
+        return false;
+    }
+    memcpy(pending + conn->pending_length, data, length);
+    conn->pending = pending;
+    conn->pending_length += length;
+    return true;
+}
+
+// Function to send a response, keeping whatever the socket does not take
+// for when it becomes writable again. Returns false when the connection
+// failed.
+bool send_response(Connection* conn, const char* data, size_t length) {
+    size_t offset = 0;
+    while (!conn->pending && offset < length) {
+        metric_add(&server_stats->syscalls, 1);
+        ssize_t sent = send(conn->fd, data + offset, length - offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("send failed");
+            return false;
+        }
+        metric_add(&server_stats->bytes_out, sent);
+        offset += sent;
+    }
+    return queue_output(conn, data + offset, length - offset);
+}
+
+// Function to send a batch of framed replies with one vectored write per
+// attempt, keeping whatever the socket does not take for when it becomes
+// writable again. Returns false when the connection failed.
+bool send_batch(Connection* conn, FrameBatch* batch) {
+    struct iovec* iov = batch->iov;
+    int count = 2 * batch->frames;
+    while (!conn->pending && count > 0) {
+        // sendmsg rather than writev, which cannot suppress SIGPIPE
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        metric_add(&server_stats->syscalls, 1);
+        ssize_t sent = sendmsg(conn->fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("sendmsg failed");
+            return false;
+        }
+        metric_add(&server_stats->bytes_out, sent);
+        
+        // Skip what was sent, ending inside the first iovec not fully sent
+        while (count > 0 && (size_t)sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    
+    // The replies point into buffers about to be reused, so copy the rest
+    for (; count > 0; iov++, count--) {
+        if (!queue_output(conn, iov->iov_base, iov->iov_len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to process one received message into its response. Returns
+// the response length.
+int process_message(const char* data, size_t length, char* response) {
+    // Convert received data to network byte order (if needed)
+    uint32_t value = 0;
+    memcpy(&value, data, length < sizeof(value) ? length : sizeof(value));
+    value = ntohl(value);
+    
+    // Process the received data
+    metric_add(&server_stats->requests, 1);
+    
+    // Prepare response
+    return snprintf(response, BUFFER_SIZE, "Processed value: %u", value);
+}
+
+// Function to read a frame's payload length from its header
+uint32_t frame_payload_length(const char* header) {
+    uint32_t length;
+    memcpy(&length, header, sizeof(length));
+    return ntohl(length);
+}
+
+// Function to process one framed request and add its reply to the batch.
+// The reply echoes the payload, so it needs no formatting and no copy.
+void add_frame_reply(FrameBatch* batch, const char* payload, uint32_t length) {
+    metric_add(&server_stats->requests, 1);
+    
+    int i = batch->frames++;
+    batch->headers[i] = htonl(length);
+    batch->iov[2 * i].iov_base = &batch->headers[i];
+    batch->iov[2 * i].iov_len = FRAME_HEADER_SIZE;
+    batch->iov[2 * i + 1].iov_base = (void*)payload;
+    batch->iov[2 * i + 1].iov_len = length;
+}
+
+// Function to parse the frames in a chunk of input into reply batches.
+// A frame split across reads is gathered in the parser and finished by
+// the chunks that follow. Returns the bytes consumed, which fall short of
+// the chunk when the batch fills up or its replies still point into the
+// partial frame the rest of the chunk would overwrite; send the batch and
+// call again with the rest. Returns -1 on a frame over FRAME_MAX_PAYLOAD.
+ssize_t parse_frames(FrameParser* parser, const char* data, size_t length, FrameBatch* batch) {
+    size_t offset = 0;
+    
+    // Finish the frame carried over from earlier reads: its header, then
+    // its payload
+    if (parser->partial_length > 0) {
+        size_t wanted = FRAME_HEADER_SIZE;
+        while (offset < length) {
+            if (parser->partial_length >= FRAME_HEADER_SIZE) {
+                wanted = FRAME_HEADER_SIZE + frame_payload_length(parser->partial);
+                if (wanted - FRAME_HEADER_SIZE > FRAME_MAX_PAYLOAD ||
+                    !reserve_buffer(&parser->partial, &parser->partial_capacity, wanted)) {
+                    return -1;
+                }
+                if (parser->partial_length == wanted) {
+                    break;
+                }
+            }
+            size_t take = wanted - parser->partial_length;
+            if (take > length - offset) {
+                take = length - offset;
+            }
+            memcpy(parser->partial + parser->partial_length, data + offset, take);
+            parser->partial_length += take;
+            offset += take;
+        }
+        if (parser->partial_length < FRAME_HEADER_SIZE ||
+            parser->partial_length < FRAME_HEADER_SIZE + frame_payload_length(parser->partial)) {
+            return offset;
+        }
+        add_frame_reply(batch, parser->partial + FRAME_HEADER_SIZE,
+                        parser->partial_length - FRAME_HEADER_SIZE);
+        parser->partial_length = 0;
+        batch->holds_partial = true;
+    }
+    
+    // Whole frames reply straight from the chunk
+    while (batch->frames < FRAME_BATCH && length - offset >= FRAME_HEADER_SIZE) {
+        uint32_t payload = frame_payload_length(data + offset);
+        if (payload > FRAME_MAX_PAYLOAD) {
+            return -1;
+        }
+        if (length - offset < FRAME_HEADER_SIZE + payload) {
+            break;
+        }
+        add_frame_reply(batch, data + offset + FRAME_HEADER_SIZE, payload);
+        offset += FRAME_HEADER_SIZE + payload;
+    }
+    
+    // Carry a trailing piece of a frame to the next read
+    if (batch->frames < FRAME_BATCH && offset < length && !batch->holds_partial) {
+        size_t rest = length - offset;
+        size_t capacity = rest < FRAME_HEADER_SIZE ? FRAME_HEADER_SIZE : rest;
+        if (!reserve_buffer(&parser->partial, &parser->partial_capacity, capacity)) {
+            return -1;
+        }
+        memcpy(parser->partial, data + offset, rest);
+        parser->partial_length = rest;
+        offset = length;
+    }
+    return offset;
+}
+
+// Function to answer the framed requests in a chunk of input, one batch
+// at a time. Returns false when the connection should be closed.
+bool answer_frames(Connection* conn, const char* data, size_t length, uint64_t received_at) {
+    FrameBatch batch;
+    size_t offset = 0;
+    while (offset < length) {
+        batch.frames = 0;
+        batch.holds_partial = false;
+        ssize_t used = parse_frames(&conn->parser, data + offset, length - offset, &batch);
+        if (used < 0) {
+            printf("Bad frame, closing connection\n");
+            return false;
+        }
+        offset += used;
+        if (!send_batch(conn, &batch)) {
+            return false;
+        }
+        if (batch.frames > 0) {
+            record_latency(now_ns() - received_at, batch.frames);
+        }
+    }
+    return true;
+}
+
+// Function to send what is left of a payload reply's body from the
+// protocol's source. Returns false when the connection failed; stops
+// early, with the body still set, when the socket is full.
+bool send_body(Connection* conn) {
+    while (conn->body_offset < conn->body_length) {
+        size_t length = conn->body_length - conn->body_offset;
+        ssize_t sent;
+        metric_add(&server_stats->syscalls, 1);
+        if (protocol == PROTOCOL_FILE) {
+            // Page cache straight to the socket, never through user space
+            off_t offset = conn->body_offset;
+            sent = sendfile(conn->fd, payload_file, &offset, length);
+        } else if (protocol == PROTOCOL_ZEROCOPY) {
+            // The kernel pins the pages instead of copying them and reports
+            // on the error queue when it lets go of them
+            sent = send(conn->fd, payload_buffer + conn->body_offset, length,
+                        MSG_NOSIGNAL | MSG_ZEROCOPY);
+            if (sent >= 0) {
+                conn->zerocopy_inflight++;
+                metric_add(&server_stats->zerocopy_sends, 1);
+            } else if (errno == ENOBUFS && conn->zerocopy_inflight > 0) {
+                // Out of option memory for pinned pages; completions will
+                // free some and wake the connection through EPOLLERR
+                return true;
+            }
+        } else {
+            sent = send(conn->fd, payload_buffer + conn->body_offset, length, MSG_NOSIGNAL);
+        }
+        
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("send failed");
+            return false;
+        }
+        metric_add(&server_stats->bytes_out, sent);
+        conn->body_offset += sent;
+    }
+    
+    record_latency(now_ns() - conn->body_started, 1);
+    conn->body_offset = 0;
+    conn->body_length = 0;
+    return true;
+}
+
+// Function to read MSG_ZEROCOPY completions off the error queue. Each
+// covers a range of sends whose pages the kernel has released; one marked
+// copied means the route made the kernel copy anyway, as loopback always
+// does. Returns false when the socket also has a real error.
+bool reap_zerocopy(Connection* conn) {
+    while (1) {
+        char control[128];
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        metric_add(&server_stats->syscalls, 1);
+        if (recvmsg(conn->fd, &message, MSG_ERRQUEUE) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("recvmsg failed");
+                return false;
+            }
+            break;
+        }
+        
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            struct sock_extended_err* error = (struct sock_extended_err*)CMSG_DATA(cmsg);
+            if (error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            uint32_t completed = error->ee_data - error->ee_info + 1;
+            conn->zerocopy_inflight -= completed;
+            if (error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                metric_add(&server_stats->zerocopy_copied, completed);
+            }
+        }
+    }
+    
+    int error = 0;
+    socklen_t length = sizeof(error);
+    metric_add(&server_stats->syscalls, 1);
+    getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+    return error == 0;
+}
+
+// Function to keep received payload requests until they can be answered.
+// Returns false when they cannot be stored.
+bool queue_payload_requests(Connection* conn, const char* data, size_t length) {
+    FrameParser* parser = &conn->parser;
+    if (!reserve_buffer(&parser->partial, &parser->partial_capacity, parser->partial_length + length)) {
+        printf("Failed to queue requests\n");
+        return false;
+    }
+    memcpy(parser->partial + parser->partial_length, data, length);
+    parser->partial_length += length;
+    return true;
+}
+
+// Function to answer queued payload requests in order, each with its
+// length and then its body, until one of them fills the socket. Returns
+// false when the connection should be closed.
+bool answer_payload_requests(Connection* conn) {
+    FrameParser* parser = &conn->parser;
+    size_t used = 0;
+    while (!conn->pending && conn->body_length == 0 && parser->partial_length - used >= sizeof(uint32_t)) {
+        uint32_t length = frame_payload_length(parser->partial + used);
+        used += sizeof(uint32_t);
+        if (length > PAYLOAD_MAX) {
+            printf("Payload of %u bytes requested, closing connection\n", length);
+            return false;
+        }
+        metric_add(&server_stats->requests, 1);
+        
+        // The header is held back until the body joins it in a segment.
+        // Latency runs from here, since the request may have waited in
+        // the queue behind earlier bodies.
+        conn->body_started = now_ns();
+        uint32_t header = htonl(length);
+        metric_add(&server_stats->syscalls, 1);
+        ssize_t sent = send(conn->fd, &header, sizeof(header), MSG_NOSIGNAL | (length ? MSG_MORE : 0));
+        if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("send failed");
+            return false;
+        }
+        metric_add(&server_stats->bytes_out, sent > 0 ? sent : 0);
+        if (sent < (ssize_t)sizeof(header) &&
+            !queue_output(conn, (char*)&header + (sent > 0 ? sent : 0),
+                          sizeof(header) - (sent > 0 ? sent : 0))) {
+            return false;
+        }
+        
+        conn->body_offset = 0;
+        conn->body_length = length;
+        if (!conn->pending && !send_body(conn)) {
+            return false;
+        }
+    }
+    
+    memmove(parser->partial, parser->partial + used, parser->partial_length - used);
+    parser->partial_length -= used;
+    return true;
+}
+
+// Function to handle client connection. Called by the event loop when the
+// socket is readable; reads until the socket runs dry, since an
+// edge-triggered socket reports new data only once. Returns false when the
+// connection should be closed.
+bool handle_client(Connection* conn) {
+    char buffer[FRAME_RECV_SIZE];
+    ssize_t bytes_received;
+    
+    while (1) {
+        // Leave further requests in the socket while responses are backed
+        // up, so a client that does not read cannot grow our memory
+        if (conn->pending || conn->body_length > 0) {
+            conn->read_paused = true;
+            return true;
+        }
+        conn->read_paused = false;
+        
+        // Receive data from client; a bare value is taken from the start
+        // of a read, so keep those reads small
+        metric_add(&server_stats->syscalls, 1);
+        bytes_received = recv(conn->fd, buffer, protocol == PROTOCOL_RAW ? BUFFER_SIZE : FRAME_RECV_SIZE, 0);
+        
+        if (bytes_received <= 0) {
+            if (bytes_received == 0 || errno == ECONNRESET) {
+                if (log_traffic) {
+                    printf("Client disconnected\n");
+                }
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                perror("recv failed");
+            }
+            return false;
+        }
+        metric_add(&server_stats->bytes_in, bytes_received);
+        uint64_t received_at = now_ns();
+        
+        // Process the received data
+        if (protocol == PROTOCOL_FRAMED) {
+            if (!answer_frames(conn, buffer, bytes_received, received_at)) {
+                return false;
+            }
+            continue;
+        }
+        if (protocol != PROTOCOL_RAW) {
+            if (!queue_payload_requests(conn, buffer, bytes_received) ||
+                !answer_payload_requests(conn)) {
+                return false;
+            }
+            continue;
+        }
+        char response[BUFFER_SIZE];
+        int length = process_message(buffer, bytes_received, response);
+        
+        // Send response back to client
+        if (!send_response(conn, response, length)) {
+            return false;
+        }
+        record_latency(now_ns() - received_at, 1);
+    }
+}
+
+// Function to accept every connection waiting on the listener
+void accept_connections(EventLoop* loop) {
+    while (1) {
+        struct sockaddr_in address;
+        socklen_t addrlen = sizeof(address);
+        metric_add(&server_stats->syscalls, 1);
+        int fd = accept4(loop->listen_fd, (struct sockaddr*)&address, &addrlen,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && loop->spare_fd >= 0) {
+                // Out of descriptors. The listener will not signal again for
+                // the connections already queued, so free the spare one to
+                // accept and drop a client rather than stall.
+                close(loop->spare_fd);
+                fd = accept(loop->listen_fd, NULL, NULL);
+                if (fd >= 0) {
+                    close(fd);
+                }
+                loop->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                printf("Out of file descriptors, dropped a connection\n");
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("Accept failed");
+            }
+            return;
+        }
+        
+        // Replies are small and latency matters more than segment count
+        int opt = 1;
+        metric_add(&server_stats->syscalls, 1);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        if (protocol == PROTOCOL_ZEROCOPY) {
+            metric_add(&server_stats->syscalls, 1);
+            setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt));
+        }
+        
+        Connection* conn = open_connection(loop, fd);
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        metric_add(&server_stats->accepts, 1);
+        
+        // Print client information
+        if (log_traffic) {
+            char client_ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &(address.sin_addr), client_ip, INET_ADDRSTRLEN);
+            printf("Client connected from %s:%d\n", client_ip, ntohs(address.sin_port));
+        }
+    }
+}
+
+// Function to serve readiness events until the reactor is stopped
+void run_event_loop(EventLoop* loop) {
+    struct epoll_event events[MAX_EVENTS];
+    
+    while (!atomic_load(loop->stopping)) {
+        metric_add(&server_stats->syscalls, 1);
+        int ready = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait failed");
+            return;
+        }
+        
+        for (int i = 0; i < ready; i++) {
+            Connection* conn = (Connection*)events[i].data.ptr;
+            if (!conn) {
+                accept_connections(loop);
+                continue;
+            }
+            if (conn == (Connection*)&loop->wake_fd) {
+                continue;
+            }
+            
+            // Zero-copy completions also arrive as EPOLLERR
+            uint32_t flags = events[i].events;
+            bool keep = !(flags & EPOLLERR) || (protocol == PROTOCOL_ZEROCOPY && reap_zerocopy(conn));
+            if (keep && (flags & EPOLLOUT) && conn->pending) {
+                keep = flush_pending(conn);
+            }
+            
+            // Then the rest of a payload body and the requests behind it
+            if (keep && !conn->pending && conn->body_length > 0) {
+                keep = send_body(conn) && answer_payload_requests(conn);
+            }
+            
+            // A flush that freed a paused connection must read on: the
+            // socket will not report the input it already holds again
+            if (keep && ((flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) ||
+                         (conn->read_paused && !conn->pending && conn->body_length == 0))) {
+                keep = handle_client(conn);
+            }
+            if (!keep) {
+                close_connection(loop, conn);
+            }
+        }
+    }
+}
+
+// Function to serve a reactor's clients from the epoll event loop until
+// the reactor is stopped
+void run_epoll_server(Reactor* reactor) {
+    // Set up the event loop, with the listener marked by a NULL connection
+    // and the wake-up eventfd by the address of its descriptor
+    EventLoop loop;
+    memset(&loop, 0, sizeof(loop));
+    loop.listen_fd = reactor->listen_fd;
+    loop.wake_fd = reactor->wake_fd;
+    loop.stopping = &reactor->stopping;
+    loop.spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop.epoll_fd < 0) {
+        perror("epoll_create1 failed");
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = NULL;
+    struct epoll_event wake_event;
+    wake_event.events = EPOLLIN;
+    wake_event.data.ptr = &loop.wake_fd;
+    if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.listen_fd, &event) < 0 ||
+        epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.wake_fd, &wake_event) < 0) {
+        perror("epoll_ctl failed");
+        exit(EXIT_FAILURE);
+    }
+    
+    run_event_loop(&loop);
+    
+    // Close all client sockets
+    while (loop.connections) {
+        close_connection(&loop, loop.connections);
+    }
+    close(loop.epoll_fd);
+    if (loop.spare_fd >= 0) {
+        close(loop.spare_fd);
+    }
+}
+
+// Function to release whatever parts of an io_uring instance were set up
+void uring_free(Uring* ring) {
+    if (ring->buf_ring) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->rings) {
+        munmap(ring->rings, ring->rings_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    free(ring->buffers);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+// Function to hand a receive buffer back to the kernel
+void uring_provide_buffer(Uring* ring, unsigned short bid) {
+    struct io_uring_buf* buf = &ring->buf_ring->bufs[ring->buf_tail & (URING_BUFFERS - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)bid * BUFFER_SIZE);
+    buf->len = BUFFER_SIZE - 1;
+    buf->bid = bid;
+    ring->buf_tail++;
+    atomic_store_explicit((_Atomic unsigned short*)&ring->buf_ring->tail, ring->buf_tail,
+                          memory_order_release);
+}
+
+// Function to create an io_uring instance with raw syscalls, map its rings
+// and register the provided buffer ring. Returns -1 with errno set when
+// the kernel lacks something the backend needs.
+int uring_init(Uring* ring) {
+    memset(ring, 0, sizeof(*ring));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN |
+                   IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = URING_CQ_ENTRIES;
+    ring->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (ring->fd < 0 && errno == EINVAL) {
+        // Older kernels reject the task-running hints, which are only hints
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = URING_CQ_ENTRIES;
+        ring->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    }
+    if (ring->fd < 0) {
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        uring_free(ring);
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    
+    // Both rings live in one mapping since IORING_FEAT_SINGLE_MMAP
+    ring->rings_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (cq_size > ring->rings_size) {
+        ring->rings_size = cq_size;
+    }
+    ring->rings = mmap(NULL, ring->rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring->fd, IORING_OFF_SQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->rings == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        int error = errno;
+        ring->rings = ring->rings == MAP_FAILED ? NULL : ring->rings;
+        ring->sqes = ring->sqes == MAP_FAILED ? NULL : ring->sqes;
+        uring_free(ring);
+        errno = error;
+        return -1;
+    }
+    
+    char* base = (char*)ring->rings;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_mask = *(unsigned*)(base + params.sq_off.ring_mask);
+    ring->sq_head = (_Atomic unsigned*)(base + params.sq_off.head);
+    ring->sq_tail = (_Atomic unsigned*)(base + params.sq_off.tail);
+    ring->sq_local_tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    ring->cq_mask = *(unsigned*)(base + params.cq_off.ring_mask);
+    ring->cq_head = (_Atomic unsigned*)(base + params.cq_off.head);
+    ring->cq_tail = (_Atomic unsigned*)(base + params.cq_off.tail);
+    ring->cqes = (struct io_uring_cqe*)(base + params.cq_off.cqes);
+    
+    // Submission slots map one to one onto the SQE array
+    unsigned* sq_array = (unsigned*)(base + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        sq_array[i] = i;
+    }
+    
+    // Provided buffers: multishot receives pick one per completion, so idle
+    // connections hold no receive memory
+    ring->buf_ring_size = URING_BUFFERS * sizeof(struct io_uring_buf);
+    ring->buf_ring = (struct io_uring_buf_ring*)mmap(NULL, ring->buf_ring_size,
+                                                     PROT_READ | PROT_WRITE,
+                                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ring->buffers = (char*)malloc((size_t)URING_BUFFERS * BUFFER_SIZE);
+    if (ring->buf_ring == MAP_FAILED || !ring->buffers) {
+        ring->buf_ring = ring->buf_ring == MAP_FAILED ? NULL : ring->buf_ring;
+        uring_free(ring);
+        errno = ENOMEM;
+        return -1;
+    }
+    
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = URING_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int error = errno;
+        uring_free(ring);
+        errno = error;
+        return -1;
+    }
+    for (unsigned i = 0; i < URING_BUFFERS; i++) {
+        uring_provide_buffer(ring, i);
+    }
+    return 0;
+}
+
+// Function to publish the filled SQEs and, when wait is set, block until
+// at least one completion arrives. Everything queued since the last call
+// goes in one syscall, which is what batches a loop iteration's I/O.
+// Returns the number submitted or a negative errno.
+int uring_submit(Uring* ring, bool wait) {
+    atomic_store_explicit(ring->sq_tail, ring->sq_local_tail, memory_order_release);
+    unsigned to_submit = ring->sq_local_tail - atomic_load_explicit(ring->sq_head, memory_order_acquire);
+    metric_add(&server_stats->syscalls, 1);
+    int ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait ? 1 : 0,
+                      wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    return ret < 0 ? -errno : ret;
+}
+
+// Function to get a cleared SQE, submitting the queued ones first if the
+// queue is full. Returns NULL when the kernel takes none.
+struct io_uring_sqe* uring_get_sqe(Uring* ring) {
+    if (ring->sq_local_tail - atomic_load_explicit(ring->sq_head, memory_order_acquire) ==
+        ring->sq_entries) {
+        uring_submit(ring, false);
+        if (ring->sq_local_tail - atomic_load_explicit(ring->sq_head, memory_order_acquire) ==
+            ring->sq_entries) {
+            return NULL;
+        }
+    }
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+// Function to check that the kernel supports every opcode the backend
+// submits, and multishot receives, which came later (6.0) than provided
+// buffer rings and multishot accept (5.19). A receive is armed on a
+// socket pair and fed one byte: an older kernel fails it with EINVAL
+// where a newer one keeps it armed. Returns -1 with errno set to
+// EOPNOTSUPP when something is missing.
+int uring_probe(Uring* ring) {
+    static const unsigned char opcodes[] = {
+        IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_POLL_ADD
+    };
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*)calloc(1, probe_size);
+    if (!probe) {
+        errno = ENOMEM;
+        return -1;
+    }
+    bool supported = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; supported && i < sizeof(opcodes); i++) {
+        supported = opcodes[i] < probe->ops_len &&
+                    (probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    if (!supported) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+        return -1;
+    }
+    struct io_uring_sqe* sqe = uring_get_sqe(ring);
+    if (!sqe) {
+        close(pair[0]);
+        close(pair[1]);
+        errno = EBUSY;
+        return -1;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = pair[0];
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = URING_OP_RECV;
+    
+    // Wait for the receive's last completion; the first one that still
+    // leaves it armed proves multishot support, and a shutdown ends it
+    char byte = 0;
+    bool multishot = false;
+    bool done = false;
+    if (write(pair[1], &byte, 1) != 1) {
+        done = true;
+    }
+    while (!done) {
+        int ret = uring_submit(ring, true);
+        if (ret < 0 && ret != -EINTR) {
+            break;
+        }
+        unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+        for (; head != tail; head++) {
+            struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+            if (cqe->flags & IORING_CQE_F_BUFFER) {
+                uring_provide_buffer(ring, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            }
+            if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_MORE)) {
+                multishot = true;
+                shutdown(pair[0], SHUT_RDWR);
+            }
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                done = true;
+            }
+        }
+        atomic_store_explicit(ring->cq_head, head, memory_order_release);
+    }
+    close(pair[0]);
+    close(pair[1]);
+    
+    if (!done || !multishot) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    return 0;
+}
+
+// Function to arm the multishot accept, which keeps posting a completion
+// per new connection until the kernel ends it
+void uring_arm_accept(UringServer* server) {
+    struct io_uring_sqe* sqe = uring_get_sqe(&server->ring);
+    if (!sqe) {
+        printf("Submission queue full, cannot accept\n");
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = URING_OP_ACCEPT;
+}
+
+// Function to wait for the reactor's wake-up eventfd
+void uring_arm_wake(UringServer* server) {
+    struct io_uring_sqe* sqe = uring_get_sqe(&server->ring);
+    if (!sqe) {
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = server->wake_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = URING_OP_WAKE;
+}
+
+// Function to mark a connection for closing. A shutdown ends the
+// operations the kernel still holds; uring_finish_connection frees the
+// connection once their last completion has arrived.
+void uring_close_connection(UringConnection* conn) {
+    conn->closing = true;
+    if (conn->inflight > 0 && !conn->shut_down) {
+        metric_add(&server_stats->syscalls, 1);
+        shutdown(conn->fd, SHUT_RDWR);
+        conn->shut_down = true;
+    }
+}
+
+// Function to free a closing connection with nothing left in flight.
+// Called last by every completion handler, so nothing touches the
+// connection afterwards.
+void uring_finish_connection(UringServer* server, UringConnection* conn) {
+    if (!conn->closing || conn->inflight > 0) {
+        return;
+    }
     
-    // Close all client sockets
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] != -1) {
-            close(client_sockets[i]);
-            client_sockets[i] = -1;
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        server->connections = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    server->active--;
+    metric_set(&server_stats->active_connections, server->active);
+    metric_add(&server_stats->syscalls, 1);
+    close(conn->fd);
+    free(conn->send_buffer);
+    free(conn->queue_buffer);
+    free(conn->parser.partial);
+    free(conn);
+}
+
+// Function to arm a multishot receive drawing from the provided buffers
+void uring_arm_recv(UringServer* server, UringConnection* conn) {
+    struct io_uring_sqe* sqe = uring_get_sqe(&server->ring);
+    if (!sqe) {
+        uring_close_connection(conn);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | URING_OP_RECV;
+    conn->inflight++;
+}
+
+// Function to send the unsent part of the send buffer
+void uring_start_send(UringServer* server, UringConnection* conn) {
+    struct io_uring_sqe* sqe = uring_get_sqe(&server->ring);
+    if (!sqe) {
+        uring_close_connection(conn);
+        return;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(conn->send_buffer + conn->send_offset);
+    sqe->len = conn->send_length - conn->send_offset;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | URING_OP_SEND;
+    conn->inflight++;
+}
+
+// Function to gather a response to some requests from its pieces into the
+// send buffer, or queue it behind the send in flight. A client that lets
+// URING_MAX_QUEUED bytes pile up is dropped, since a multishot receive
+// cannot be paused the way the epoll loop stops reading.
+void uring_queue_response(UringServer* server, UringConnection* conn, const struct iovec* iov,
+                          int count, uint64_t requests, uint64_t received_at) {
+    size_t length = 0;
+    for (int i = 0; i < count; i++) {
+        length += iov[i].iov_len;
+    }
+    
+    bool idle = conn->send_length == 0;
+    char** buffer = idle ? &conn->send_buffer : &conn->queue_buffer;
+    size_t* capacity = idle ? &conn->send_capacity : &conn->queue_capacity;
+    size_t* used = idle ? &conn->send_length : &conn->queue_length;
+    if (!idle && *used + length > URING_MAX_QUEUED) {
+        printf("Client not reading responses, dropping it\n");
+        uring_close_connection(conn);
+        return;
+    }
+    if (!reserve_buffer(buffer, capacity, *used + length)) {
+        uring_close_connection(conn);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(*buffer + *used, iov[i].iov_base, iov[i].iov_len);
+        *used += iov[i].iov_len;
+    }
+    
+    if (idle && length > 0) {
+        conn->send_offset = 0;
+        uring_start_send(server, conn);
+    }
+    
+    // The clock stops once the reply is buffered, as the epoll loop stops
+    // it after send(); waiting for the send to complete would charge every
+    // request with the round trip of the send ahead of it
+    if (requests > 0) {
+        record_latency(now_ns() - received_at, requests);
+    }
+}
+
+// Function to answer the framed requests in a received chunk. A batch's
+// replies go out together in the next send.
+void uring_answer_frames(UringServer* server, UringConnection* conn, const char* data,
+                         size_t length, uint64_t received_at) {
+    FrameBatch batch;
+    size_t offset = 0;
+    while (offset < length && !conn->closing) {
+        batch.frames = 0;
+        batch.holds_partial = false;
+        ssize_t used = parse_frames(&conn->parser, data + offset, length - offset, &batch);
+        if (used < 0) {
+            printf("Bad frame, closing connection\n");
+            uring_close_connection(conn);
+            return;
         }
+        offset += used;
+        uring_queue_response(server, conn, batch.iov, 2 * batch.frames, batch.frames, received_at);
+    }
+}
+
+// Function to set up an accepted connection and start receiving on it
+void uring_open_connection(UringServer* server, int fd) {
+    UringConnection* conn = (UringConnection*)calloc(1, sizeof(UringConnection));
+    if (!conn) {
+        printf("Failed to allocate connection\n");
+        metric_add(&server_stats->syscalls, 1);
+        close(fd);
+        return;
+    }
+    conn->fd = fd;
+    conn->next = server->connections;
+    if (server->connections) {
+        server->connections->prev = conn;
+    }
+    server->connections = conn;
+    server->active++;
+    metric_add(&server_stats->accepts, 1);
+    metric_set(&server_stats->active_connections, server->active);
+    
+    // Replies are small and latency matters more than segment count
+    int opt = 1;
+    metric_add(&server_stats->syscalls, 1);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    
+    // Print client information; a multishot accept shares one address
+    // buffer between completions, so ask the socket instead
+    struct sockaddr_in address;
+    socklen_t addrlen = sizeof(address);
+    metric_add(&server_stats->syscalls, log_traffic);
+    if (log_traffic && getpeername(fd, (struct sockaddr*)&address, &addrlen) == 0) {
+        char client_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(address.sin_addr), client_ip, INET_ADDRSTRLEN);
+        printf("Client connected from %s:%d\n", client_ip, ntohs(address.sin_port));
     }
     
-    // Close server socket
-    if (server_fd != -1) {
-        close(server_fd);
-        server_fd = -1;
+    uring_arm_recv(server, conn);
+    uring_finish_connection(server, conn);
+}
+
+// Function to handle an accept completion
+void uring_handle_accept(UringServer* server, struct io_uring_cqe* cqe) {
+    if (cqe->res >= 0) {
+        server->accepted = true;
+        uring_open_connection(server, cqe->res);
+    } else if (cqe->res == -EINVAL && !server->accepted) {
+        // Kernel without multishot accept
+        server->unsupported = true;
+        return;
+    } else if ((cqe->res == -EMFILE || cqe->res == -ENFILE) && server->spare_fd >= 0) {
+        // Out of descriptors: free the spare one to accept and drop a
+        // client, as the epoll loop does
+        close(server->spare_fd);
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd >= 0) {
+            close(fd);
+        }
+        server->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        metric_add(&server_stats->syscalls, 3);
+        printf("Out of file descriptors, dropped a connection\n");
+    } else if (cqe->res != -EINTR && cqe->res != -ECONNABORTED) {
+        printf("Accept failed: %s\n", strerror(-cqe->res));
     }
     
-    exit(0);
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        uring_arm_accept(server);
+    }
 }
 
-// Function to handle client connection
-void handle_client(int client_socket) {
-    char buffer[BUFFER_SIZE];
-    ssize_t bytes_received;
+// Function to handle a receive completion: process the message in the
+// picked buffer and return the buffer to the kernel
+void uring_handle_recv(UringServer* server, UringConnection* conn, struct io_uring_cqe* cqe) {
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+    if (!more) {
+        conn->inflight--;
+    }
+    
+    if (cqe->res > 0) {
+        unsigned short bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        const char* data = server->ring.buffers + (size_t)bid * BUFFER_SIZE;
+        metric_add(&server_stats->bytes_in, cqe->res);
+        uint64_t received_at = now_ns();
+        if (!conn->closing && protocol == PROTOCOL_FRAMED) {
+            uring_answer_frames(server, conn, data, cqe->res, received_at);
+        } else if (!conn->closing) {
+            char response[BUFFER_SIZE];
+            struct iovec iov;
+            iov.iov_base = response;
+            iov.iov_len = process_message(data, cqe->res, response);
+            uring_queue_response(server, conn, &iov, 1, 1, received_at);
+        }
+        uring_provide_buffer(&server->ring, bid);
+    } else if (cqe->res == 0) {
+        if (!conn->closing && log_traffic) {
+            printf("Client disconnected\n");
+        }
+        uring_close_connection(conn);
+    } else if (cqe->res != -ENOBUFS) {
+        // Out of buffers only ends the multishot receive; anything else
+        // ends the connection
+        if (!conn->closing && cqe->res != -ECONNRESET) {
+            printf("recv failed: %s\n", strerror(-cqe->res));
+        }
+        uring_close_connection(conn);
+    }
+    
+    if (!more && !conn->closing) {
+        uring_arm_recv(server, conn);
+    }
+    uring_finish_connection(server, conn);
+}
+
+// Function to handle a send completion and start the next send, if any
+void uring_handle_send(UringServer* server, UringConnection* conn, struct io_uring_cqe* cqe) {
+    conn->inflight--;
+    if (cqe->res < 0 || conn->closing) {
+        if (cqe->res < 0 && cqe->res != -EPIPE && cqe->res != -ECONNRESET) {
+            printf("send failed: %s\n", strerror(-cqe->res));
+        }
+        uring_close_connection(conn);
+        uring_finish_connection(server, conn);
+        return;
+    }
     
-    // Set socket timeout
-    struct timeval tv;
-    tv.tv_sec = 5;  // 5 seconds timeout
-    tv.tv_usec = 0;
-    if (setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
-        perror("setsockopt failed");
+    metric_add(&server_stats->bytes_out, cqe->res);
+    conn->send_offset += cqe->res;
+    if (conn->send_offset < conn->send_length) {
+        uring_start_send(server, conn);
+        uring_finish_connection(server, conn);
         return;
     }
     
-    while (1) {
-        // Clear buffer
-        memset(buffer, 0, BUFFER_SIZE);
-        
-        // Receive data from client
-        bytes_received = recv(client_socket, buffer, BUFFER_SIZE - 1, 0);
-        
-        if (bytes_received <= 0) {
-            if (bytes_received == 0) {
-                printf("Client disconnected\n");
-            } else {
-                perror("recv failed");
-            }
+    // Everything sent: the queued responses become the next send
+    char* buffer = conn->send_buffer;
+    size_t capacity = conn->send_capacity;
+    conn->send_buffer = conn->queue_buffer;
+    conn->send_capacity = conn->queue_capacity;
+    conn->send_length = conn->queue_length;
+    conn->send_offset = 0;
+    conn->queue_buffer = buffer;
+    conn->queue_capacity = capacity;
+    conn->queue_length = 0;
+    if (conn->send_length > 0) {
+        uring_start_send(server, conn);
+    }
+    uring_finish_connection(server, conn);
+}
+
+// Function to serve a reactor's clients from io_uring completions until
+// the reactor is stopped. Returns -1 without serving anyone when the
+// kernel cannot run this backend, so the caller can fall back to epoll.
+int run_uring_server(Reactor* reactor) {
+    UringServer server;
+    memset(&server, 0, sizeof(server));
+    if (uring_init(&server.ring) < 0) {
+        printf("io_uring backend unavailable: %s\n", strerror(errno));
+        return -1;
+    }
+    if (uring_probe(&server.ring) < 0) {
+        printf("io_uring backend unavailable: no multishot receive (%s)\n", strerror(errno));
+        uring_free(&server.ring);
+        return -1;
+    }
+    server.listen_fd = reactor->listen_fd;
+    server.wake_fd = reactor->wake_fd;
+    server.stopping = &reactor->stopping;
+    server.spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    uring_arm_accept(&server);
+    uring_arm_wake(&server);
+    
+    while (!atomic_load(server.stopping) && !server.unsupported) {
+        int ret = uring_submit(&server.ring, true);
+        if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+            printf("io_uring_enter failed: %s\n", strerror(-ret));
             break;
         }
         
-        // Convert received data to network byte order (if needed)
-        uint32_t value;
-        memcpy(&value, buffer, sizeof(value));
-        value = ntohl(value);
-        
-        // Process the received data
-        printf("Received: %u\n", value);
-        
-        // Prepare response
-        char response[BUFFER_SIZE];
-        snprintf(response, BUFFER_SIZE, "Processed value: %u", value);
-        
-        // Send response back to client
-        if (send(client_socket, response, strlen(response), 0) < 0) {
-            perror("send failed");
-            break;
+        // Handle every completion posted so far before submitting again
+        unsigned head = atomic_load_explicit(server.ring.cq_head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(server.ring.cq_tail, memory_order_acquire);
+        for (; head != tail; head++) {
+            struct io_uring_cqe* cqe = &server.ring.cqes[head & server.ring.cq_mask];
+            UringConnection* conn = (UringConnection*)(uintptr_t)(cqe->user_data & ~(uint64_t)URING_OP_MASK);
+            switch (cqe->user_data & URING_OP_MASK) {
+                case URING_OP_ACCEPT:
+                    uring_handle_accept(&server, cqe);
+                    break;
+                case URING_OP_RECV:
+                    uring_handle_recv(&server, conn, cqe);
+                    break;
+                case URING_OP_SEND:
+                    uring_handle_send(&server, conn, cqe);
+                    break;
+                case URING_OP_WAKE:
+                    // Nothing to do: the loop condition sees the stop
+                    break;
+            }
+        }
+        atomic_store_explicit(server.ring.cq_head, head, memory_order_release);
+    }
+    
+    // Tearing down the ring cancels everything still in flight
+    bool unsupported = server.unsupported;
+    uring_free(&server.ring);
+    while (server.connections) {
+        UringConnection* conn = server.connections;
+        server.connections = conn->next;
+        close(conn->fd);
+        free(conn->send_buffer);
+        free(conn->queue_buffer);
+        free(conn->parser.partial);
+        free(conn);
+    }
+    metric_set(&server_stats->active_connections, 0);
+    if (server.spare_fd >= 0) {
+        close(server.spare_fd);
+    }
+    
+    if (unsupported) {
+        printf("io_uring backend unavailable: no multishot accept\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Function to create the static payload of the payload protocols: a
+// buffer of PAYLOAD_MAX patterned bytes and an unlinked file holding the
+// same bytes. Returns -1 when either cannot be made.
+int setup_payload() {
+    payload_buffer = (char*)malloc(PAYLOAD_MAX);
+    if (!payload_buffer) {
+        printf("Failed to allocate payload\n");
+        return -1;
+    }
+    for (size_t i = 0; i < PAYLOAD_MAX; i++) {
+        payload_buffer[i] = 'a' + i % 26;
+    }
+    
+    char path[] = "/tmp/payload-XXXXXX";
+    payload_file = mkstemp(path);
+    if (payload_file < 0) {
+        perror("mkstemp failed");
+        return -1;
+    }
+    unlink(path);
+    for (size_t written = 0; written < PAYLOAD_MAX; ) {
+        ssize_t bytes = write(payload_file, payload_buffer + written, PAYLOAD_MAX - written);
+        if (bytes < 0) {
+            perror("write failed");
+            return -1;
         }
+        written += bytes;
     }
+    return 0;
 }
 
-int main() {
-    int new_socket;
+// Function to create the non-blocking listening socket on PORT
+int create_listener() {
     struct sockaddr_in address;
     int opt = 1;
-    int addrlen = sizeof(address);
-    
-    // Register signal handlers
-    signal(SIGINT, handle_signal);
-    signal(SIGTERM, handle_signal);
+    int fd;
     
     // Create socket
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         perror("Socket failed");
         exit(EXIT_FAILURE);
     }
     
     // Set socket options
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt))) {
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
         perror("Setsockopt failed");
         exit(EXIT_FAILURE);
     }
@@ -114,42 +1690,602 @@ int main() {
     address.sin_port = htons(PORT);
     
     // Bind socket
-    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
         perror("Bind failed");
         exit(EXIT_FAILURE);
     }
     
     // Listen for connections
-    if (listen(server_fd, 3) < 0) {
+    if (listen(fd, LISTEN_BACKLOG) < 0 || set_nonblocking(fd) < 0) {
         perror("Listen failed");
         exit(EXIT_FAILURE);
     }
+    return fd;
+}
+
+// Function to pin the calling thread to the index-th CPU the process may
+// run on (taskset, cgroup cpusets), wrapping around them
+void pin_to_cpu(int index) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        perror("sched_getaffinity failed");
+        return;
+    }
+    int count = CPU_COUNT(&allowed);
+    if (count == 0) {
+        return;
+    }
+    
+    int skip = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || skip-- > 0) {
+            continue;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (error != 0) {
+            printf("Failed to pin thread to CPU %d: %s\n", cpu, strerror(error));
+        }
+        return;
+    }
+}
+
+// Function run by each reactor thread
+void* reactor_main(void* arg) {
+    Reactor* reactor = (Reactor*)arg;
+    server_stats = &reactor->stats;
+    pin_to_cpu(reactor->id);
     
-    printf("Server listening on port %d...\n", PORT);
+    if (reactor->use_uring && run_uring_server(reactor) < 0) {
+        printf("Reactor %d falling back to epoll\n", reactor->id);
+        atomic_store(&reactor->fell_back, true);
+    }
+    if (!reactor->use_uring || atomic_load(&reactor->fell_back)) {
+        run_epoll_server(reactor);
+    }
     
-    // Accept connection
-    if ((new_socket = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen)) < 0) {
-        perror("Accept failed");
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    reactor->cpu_ns = (uint64_t)cpu.tv_sec * 1000000000ULL + cpu.tv_nsec;
+    return NULL;
+}
+
+// Function to open a reactor's listener and start its thread
+void start_reactor(Reactor* reactor, int id, bool use_uring) {
+    memset(reactor, 0, sizeof(*reactor));
+    reactor->id = id;
+    reactor->use_uring = use_uring;
+    reactor->listen_fd = create_listener();
+    reactor->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (reactor->wake_fd < 0) {
+        perror("eventfd failed");
         exit(EXIT_FAILURE);
     }
+    atomic_init(&reactor->stopping, false);
+    atomic_init(&reactor->fell_back, false);
+    pthread_create(&reactor->thread, NULL, reactor_main, reactor);
+}
+
+// Function to stop a reactor, wait for its thread and close its listener
+void stop_reactor(Reactor* reactor) {
+    atomic_store(&reactor->stopping, true);
+    uint64_t one = 1;
+    if (write(reactor->wake_fd, &one, sizeof(one)) < 0) {
+        perror("eventfd write failed");
+    }
+    pthread_join(reactor->thread, NULL);
+    close(reactor->wake_fd);
+    close(reactor->listen_fd);
+}
+
+// Function to name the backend a reactor runs
+const char* reactor_backend(Reactor* reactor) {
+    if (!reactor->use_uring) {
+        return "epoll";
+    }
+    return atomic_load(&reactor->fell_back) ? "epoll*" : "io_uring";
+}
+
+// Function to write the reactors' counters and merged latency histogram.
+// Reading while the reactors run gives each value as of some recent
+// moment, not one snapshot of them all.
+void write_report(FILE* out, Reactor* reactors, int count) {
+    fprintf(out, "%-8s %-9s %10s %8s %12s %14s %14s %12s\n", "reactor", "backend", "accepts",
+            "active", "requests", "bytes in", "bytes out", "syscalls");
+    uint64_t totals[6] = { 0, 0, 0, 0, 0, 0 };
+    uint64_t zerocopy_sends = 0, zerocopy_copied = 0;
+    static uint64_t buckets[HISTOGRAM_BUCKETS];
+    memset(buckets, 0, sizeof(buckets));
+    uint64_t latency_count = 0, latency_total = 0, latency_max = 0;
+    for (int i = 0; i < count; i++) {
+        ServerStats* stats = &reactors[i].stats;
+        uint64_t values[6] = {
+            metric_read(&stats->accepts), metric_read(&stats->active_connections),
+            metric_read(&stats->requests), metric_read(&stats->bytes_in),
+            metric_read(&stats->bytes_out), metric_read(&stats->syscalls)
+        };
+        fprintf(out, "%-8d %-9s %10llu %8llu %12llu %14llu %14llu %12llu\n", i,
+                reactor_backend(&reactors[i]), (unsigned long long)values[0],
+                (unsigned long long)values[1], (unsigned long long)values[2],
+                (unsigned long long)values[3], (unsigned long long)values[4],
+                (unsigned long long)values[5]);
+        for (int j = 0; j < 6; j++) {
+            totals[j] += values[j];
+        }
+        zerocopy_sends += metric_read(&stats->zerocopy_sends);
+        zerocopy_copied += metric_read(&stats->zerocopy_copied);
+        
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            buckets[b] += metric_read(&stats->latency.buckets[b]);
+        }
+        latency_count += metric_read(&stats->latency.count);
+        latency_total += metric_read(&stats->latency.total_ns);
+        uint64_t max = metric_read(&stats->latency.max_ns);
+        latency_max = max > latency_max ? max : latency_max;
+    }
+    fprintf(out, "%-8s %-9s %10llu %8llu %12llu %14llu %14llu %12llu\n", "total", "",
+            (unsigned long long)totals[0], (unsigned long long)totals[1],
+            (unsigned long long)totals[2], (unsigned long long)totals[3],
+            (unsigned long long)totals[4], (unsigned long long)totals[5]);
+    for (int i = 0; i < count; i++) {
+        if (atomic_load(&reactors[i].fell_back)) {
+            fprintf(out, "* io_uring unavailable, fell back to epoll\n");
+            break;
+        }
+    }
+    fprintf(out, "Syscalls per request: %.2f\n", totals[2] ? (double)totals[5] / totals[2] : 0.0);
+    if (zerocopy_sends > 0) {
+        fprintf(out, "Zero-copy sends: %llu, %llu copied by the kernel\n",
+                (unsigned long long)zerocopy_sends, (unsigned long long)zerocopy_copied);
+    }
+    if (latency_count == 0) {
+        return;
+    }
+    
+    // Percentiles are the floor of the bucket holding that rank
+    double quantiles[4] = { 0.5, 0.9, 0.99, 0.999 };
+    double values[4];
+    uint64_t seen = 0;
+    int q = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS && q < 4; b++) {
+        seen += buckets[b];
+        while (q < 4 && seen > 0 && seen >= quantiles[q] * latency_count) {
+            values[q++] = histogram_bucket_floor(b) / 1e3;
+        }
+    }
+    while (q < 4) {
+        values[q++] = latency_max / 1e3;
+    }
+    fprintf(out, "Latency us: count %llu, mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+            (unsigned long long)latency_count, latency_total / 1e3 / latency_count, values[0],
+            values[1], values[2], values[3], latency_max / 1e3);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(reactor_backend(&reactors[i]), "io_uring") == 0) {
+            fprintf(out, "* io_uring latency ends when the reply is buffered for a send, epoll's after send()\n");
+            break;
+        }
+    }
+}
+
+// Function run by the admin thread: each connection gets the current
+// report as a plain-text HTTP response, whatever it asked for
+void* admin_main(void* arg) {
+    AdminEndpoint* admin = (AdminEndpoint*)arg;
+    while (1) {
+        int fd = accept4(admin->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // The listener was shut down
+            return NULL;
+        }
+        
+        // Read the request if one comes, so closing does not reset it
+        struct timeval timeout = { 0, ADMIN_RECV_TIMEOUT_MS * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        char request[BUFFER_SIZE];
+        if (recv(fd, request, sizeof(request), 0) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            close(fd);
+            continue;
+        }
+        
+        char* report = NULL;
+        size_t length = 0;
+        FILE* out = open_memstream(&report, &length);
+        if (out) {
+            fprintf(out, "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n");
+            write_report(out, admin->reactors, admin->count);
+            fclose(out);
+            for (size_t sent = 0; sent < length; ) {
+                ssize_t bytes = send(fd, report + sent, length - sent, MSG_NOSIGNAL);
+                if (bytes <= 0) {
+                    break;
+                }
+                sent += bytes;
+            }
+            free(report);
+        }
+        close(fd);
+    }
+}
+
+// Function to open the admin listener on the loopback interface and start
+// its thread. Returns -1 when the port cannot be bound.
+int start_admin(AdminEndpoint* admin, Reactor* reactors, int count) {
+    admin->reactors = reactors;
+    admin->count = count;
+    admin->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (admin->listen_fd < 0) {
+        perror("socket failed");
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(admin->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(ADMIN_PORT);
+    if (bind(admin->listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(admin->listen_fd, 16) < 0) {
+        perror("Admin endpoint failed");
+        close(admin->listen_fd);
+        return -1;
+    }
+    pthread_create(&admin->thread, NULL, admin_main, admin);
+    return 0;
+}
+
+// Function to stop the admin thread; shutting the listener down wakes
+// its accept
+void stop_admin(AdminEndpoint* admin) {
+    shutdown(admin->listen_fd, SHUT_RDWR);
+    pthread_join(admin->thread, NULL);
+    close(admin->listen_fd);
+}
+
+// Per-thread state of the benchmark's blocking clients
+typedef struct {
+    bool reconnect;  // New connection per request, to measure accepts
+    uint64_t deadline;
+    uint64_t completed;
+    uint64_t failures;
+    pthread_t thread;
+} BenchClient;
+
+// Function to connect a benchmark client to the local server. Closing
+// with a zero linger resets the connection, so the client's ports do not
+// pile up in TIME_WAIT during the connection-rate run.
+int bench_connect() {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int opt = 1;
+    struct linger linger = { 1, 0 };
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(PORT);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Function to send one request and read its whole reply
+bool bench_request(int fd, uint32_t value) {
+    uint32_t message = htonl(value);
+    if (send(fd, &message, sizeof(message), MSG_NOSIGNAL) != sizeof(message)) {
+        return false;
+    }
+    
+    char expected[BUFFER_SIZE];
+    char reply[BUFFER_SIZE];
+    int length = snprintf(expected, BUFFER_SIZE, "Processed value: %u", value);
+    for (int received = 0; received < length; ) {
+        ssize_t bytes = recv(fd, reply + received, length - received, 0);
+        if (bytes <= 0) {
+            return false;
+        }
+        received += bytes;
+    }
+    return memcmp(reply, expected, length) == 0;
+}
+
+// Function run by each benchmark client until the deadline
+void* bench_client_main(void* arg) {
+    BenchClient* client = (BenchClient*)arg;
+    int fd = -1;
+    for (uint32_t value = 0; now_ns() < client->deadline; value++) {
+        if (fd < 0 && (fd = bench_connect()) < 0) {
+            client->failures++;
+            continue;
+        }
+        if (bench_request(fd, value)) {
+            client->completed++;
+        } else {
+            client->failures++;
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        if (client->reconnect) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+// Function to run the benchmark clients for a while and return the rate
+// of completed requests (or connections, when reconnecting)
+double run_bench_clients(bool reconnect, int seconds, uint64_t* failures) {
+    BenchClient clients[BENCH_CLIENTS];
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCH_CLIENTS; i++) {
+        memset(&clients[i], 0, sizeof(BenchClient));
+        clients[i].reconnect = reconnect;
+        clients[i].deadline = start + (uint64_t)seconds * 1000000000ULL;
+        pthread_create(&clients[i].thread, NULL, bench_client_main, &clients[i]);
+    }
+    
+    uint64_t completed = 0;
+    for (int i = 0; i < BENCH_CLIENTS; i++) {
+        pthread_join(clients[i].thread, NULL);
+        completed += clients[i].completed;
+        *failures += clients[i].failures;
+    }
+    return completed * 1e9 / (now_ns() - start);
+}
+
+// Function to step the benchmark's reactor count: doubling, but always
+// finishing with the requested maximum
+int next_reactor_count(int count, int max_reactors) {
+    if (count < max_reactors && count * 2 > max_reactors) {
+        return max_reactors;
+    }
+    return count * 2;
+}
+
+// Function to measure connection and request rates with 1, 2, 4, ... up
+// to max_reactors reactors. The clients run in this process on the same
+// cores, so on a small machine they compete with the reactors and the
+// curve flattens early.
+int run_scaling_benchmark(int argc, char** argv) {
+    int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_reactors = argc > 0 ? atoi(argv[0]) : cpus;
+    int seconds = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_SECONDS;
+    bool use_uring = argc > 2 && strcmp(argv[2], "uring") == 0;
+    if (max_reactors < 1 || max_reactors > MAX_REACTORS || seconds < 1) {
+        printf("Usage: bench [max reactors 1-%d] [seconds] [epoll|uring]\n", MAX_REACTORS);
+        return 1;
+    }
+    log_traffic = false;
+    
+    printf("%d CPUs online, %d client threads, %s backend\n", cpus, BENCH_CLIENTS,
+           use_uring ? "io_uring" : "epoll");
+    printf("%-9s %14s %8s %14s %8s %10s\n", "reactors", "connections/s", "scaling",
+           "requests/s", "scaling", "failures");
+    
+    Reactor* reactors = (Reactor*)aligned_alloc(CACHE_LINE, max_reactors * sizeof(Reactor));
+    if (!reactors) {
+        printf("Failed to allocate reactors\n");
+        return 1;
+    }
+    double base_connections = 0, base_requests = 0;
+    for (int count = 1; count <= max_reactors; count = next_reactor_count(count, max_reactors)) {
+        for (int i = 0; i < count; i++) {
+            start_reactor(&reactors[i], i, use_uring);
+        }
+        
+        uint64_t failures = 0;
+        double connection_rate = run_bench_clients(true, seconds, &failures);
+        double request_rate = run_bench_clients(false, seconds, &failures);
+        if (count == 1) {
+            base_connections = connection_rate;
+            base_requests = request_rate;
+        }
+        printf("%-9d %14.0f %7.2fx %14.0f %7.2fx %10llu\n", count, connection_rate,
+               connection_rate / base_connections, request_rate, request_rate / base_requests,
+               (unsigned long long)failures);
+        
+        for (int i = 0; i < count; i++) {
+            stop_reactor(&reactors[i]);
+        }
+    }
+    free(reactors);
+    return 0;
+}
+
+// Function to request payloads of one size over a single connection
+// until the time is up. Returns the body bytes received.
+uint64_t run_payload_client(uint32_t size, int seconds, char* scratch) {
+    int fd = bench_connect();
+    if (fd < 0) {
+        perror("connect failed");
+        return 0;
+    }
     
-    // Print client information
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(address.sin_addr), client_ip, INET_ADDRSTRLEN);
-    printf("Client connected from %s:%d\n", client_ip, ntohs(address.sin_port));
+    uint64_t received = 0;
+    uint64_t deadline = now_ns() + (uint64_t)seconds * 1000000000ULL;
+    uint32_t request = htonl(size);
+    while (now_ns() < deadline) {
+        if (send(fd, &request, sizeof(request), MSG_NOSIGNAL) != sizeof(request)) {
+            break;
+        }
+        size_t wanted = sizeof(uint32_t) + size;
+        size_t got = 0;
+        uint32_t header;
+        while (got < wanted) {
+            size_t chunk = wanted - got < ZEROCOPY_RECV_SIZE ? wanted - got : ZEROCOPY_RECV_SIZE;
+            ssize_t bytes = recv(fd, scratch, chunk, 0);
+            if (bytes <= 0) {
+                close(fd);
+                return received;
+            }
+            // The length header may arrive split over several reads
+            if (got < sizeof(header)) {
+                size_t header_bytes = sizeof(header) - got < (size_t)bytes ? sizeof(header) - got : (size_t)bytes;
+                memcpy((char*)&header + got, scratch, header_bytes);
+                if (got + header_bytes == sizeof(header) && header != request) {
+                    printf("Unexpected payload reply\n");
+                    close(fd);
+                    return received;
+                }
+            }
+            got += bytes;
+        }
+        received += size;
+    }
+    close(fd);
+    return received;
+}
+
+// Function to compare the payload protocols' server CPU cost per gigabyte
+// sent at payload sizes from ZEROCOPY_MIN_SIZE to PAYLOAD_MAX. Over
+// loopback the receiver copies every byte whatever the sender does, and
+// MSG_ZEROCOPY sends get copied too, so the gains a NIC would see show
+// only in part.
+int run_zerocopy_benchmark(int argc, char** argv) {
+    int seconds = argc > 0 ? atoi(argv[0]) : ZEROCOPY_DEFAULT_SECONDS;
+    if (seconds < 1) {
+        printf("Usage: zerocopy [seconds per size]\n");
+        return 1;
+    }
+    log_traffic = false;
+    char* scratch = (char*)malloc(ZEROCOPY_RECV_SIZE);
+    if (!scratch || setup_payload() < 0) {
+        return 1;
+    }
     
-    // Handle connection
-    char buffer[BUFFER_SIZE] = {0};
-    ssize_t valread = read(new_socket, buffer, BUFFER_SIZE - 1);
-    if (valread > 0) {
-        printf("Received: %s\n", buffer);
+    printf("%-8s %-9s %10s %15s %10s\n", "size", "protocol", "MB/s", "server CPU s/GB", "copied");
+    for (uint32_t size = ZEROCOPY_MIN_SIZE; size <= PAYLOAD_MAX; size *= 4) {
+        char label[16];
+        if (size >= 1024 * 1024) {
+            snprintf(label, sizeof(label), "%uMB", size / (1024 * 1024));
+        } else {
+            snprintf(label, sizeof(label), "%uKB", size / 1024);
+        }
         
-        // Send response
-        const char* response = "Hello from server";
-        send(new_socket, response, strlen(response), 0);
+        for (int p = PROTOCOL_COPY; p <= PROTOCOL_ZEROCOPY; p++) {
+            protocol = p;
+            Reactor reactor;
+            start_reactor(&reactor, 0, false);
+            uint64_t start = now_ns();
+            uint64_t bytes = run_payload_client(size, seconds, scratch);
+            uint64_t elapsed = now_ns() - start;
+            stop_reactor(&reactor);
+            
+            char copied[16] = "-";
+            uint64_t sends = metric_read(&reactor.stats.zerocopy_sends);
+            if (sends > 0) {
+                snprintf(copied, sizeof(copied), "%.0f%%",
+                         100.0 * metric_read(&reactor.stats.zerocopy_copied) / sends);
+            }
+            printf("%-8s %-9s %10.0f %15.3f %10s\n", label, protocol_names[p], bytes * 1e3 / elapsed,
+                   bytes ? reactor.cpu_ns / (double)bytes : 0.0, copied);
+        }
+    }
+    
+    free(scratch);
+    free(payload_buffer);
+    close(payload_file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // "bench [max reactors] [seconds] [epoll|uring]" measures how the
+    // connection and request rates scale with the number of reactors
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return run_scaling_benchmark(argc - 2, argv + 2);
+    }
+    
+    // "zerocopy [seconds per size]" measures the server CPU spent per
+    // gigabyte by the copy, file and zerocopy payload protocols
+    if (argc > 1 && strcmp(argv[1], "zerocopy") == 0) {
+        return run_zerocopy_benchmark(argc - 2, argv + 2);
+    }
+    
+    // "[epoll|uring] [reactors] [protocol]" picks the backend, io_uring
+    // falling back to epoll when the kernel cannot run it, the number of
+    // reactor threads, one per core by default, and the protocol. The
+    // payload protocols (copy, file, zerocopy) run on epoll only.
+    bool use_uring = argc > 1 && strcmp(argv[1], "uring") == 0;
+    int count = argc > 2 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    protocol = argc > 3 ? PROTOCOL_COUNT : PROTOCOL_RAW;
+    for (int i = 0; argc > 3 && i < PROTOCOL_COUNT; i++) {
+        if (strcmp(argv[3], protocol_names[i]) == 0) {
+            protocol = i;
+        }
+    }
+    if ((argc > 1 && !use_uring && strcmp(argv[1], "epoll") != 0) || count < 1 ||
+        count > MAX_REACTORS || protocol == PROTOCOL_COUNT || (use_uring && protocol >= PROTOCOL_COPY)) {
+        printf("Usage: %s [epoll|uring] [reactors 1-%d] [raw|framed]\n", argv[0], MAX_REACTORS);
+        printf("       %s [epoll] [reactors 1-%d] [copy|file|zerocopy]\n", argv[0], MAX_REACTORS);
+        printf("       %s bench [max reactors] [seconds] [epoll|uring]\n", argv[0]);
+        printf("       %s zerocopy [seconds per size]\n", argv[0]);
+        return 1;
+    }
+    if (protocol >= PROTOCOL_COPY && setup_payload() < 0) {
+        return 1;
+    }
+    
+    // Block the shutdown signals in every thread; this one waits for them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    raise_fd_limit();
+    
+    Reactor* reactors = (Reactor*)aligned_alloc(CACHE_LINE, count * sizeof(Reactor));
+    if (!reactors) {
+        printf("Failed to allocate reactors\n");
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        start_reactor(&reactors[i], i, use_uring);
+    }
+    printf("Server listening on port %d with %d reactor%s, %s protocol...\n", PORT, count,
+           count > 1 ? "s" : "", protocol_names[protocol]);
+    
+    // Counters and latencies are served live on the admin port
+    AdminEndpoint admin;
+    bool admin_running = start_admin(&admin, reactors, count) == 0;
+    if (admin_running) {
+        printf("Metrics at http://127.0.0.1:%d/\n", ADMIN_PORT);
+    }
+    
+    int sig = 0;
+    sigwait(&signals, &sig);
+    printf("\nReceived signal %d, cleaning up...\n", sig);
+    
+    // Stop the reactors; each closes its client sockets and listener
+    if (admin_running) {
+        stop_admin(&admin);
+    }
+    for (int i = 0; i < count; i++) {
+        stop_reactor(&reactors[i]);
     }
+    write_report(stdout, reactors, count);
     
-    close(new_socket);
-    close(server_fd);
+    free(reactors);
+    free(payload_buffer);
+    if (payload_file >= 0) {
+        close(payload_file);
+    }
     return 0;
-} 
\ No newline at end of file
+}
@@ -2,14 +2,390 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
 
-int main() {
+// Load mode parameters
+#define LOAD_DEFAULT_CONNECTIONS 1000
+#define LOAD_DEFAULT_SECONDS 10
+#define LOAD_MAX_EVENTS 1024
+#define RESPONSE_MAX 32  // Longest "Processed value: %u" reply
+
+// Framed protocol: a 4-byte big-endian payload length, then the payload.
+// The server's reply is the same frame.
+#define FRAME_HEADER_SIZE 4
+#define FRAME_SIZE 8  // A framed 4-byte value
+#define PIPELINE_DEFAULT_DEPTH 16
+#define PIPELINE_MAX_DEPTH 128
+#define LOAD_MAX_BYTES (PIPELINE_MAX_DEPTH * FRAME_SIZE)  // Largest exchange either way
+
+// One load generator connection, with at most one exchange in flight: a
+// bare value, or a pipeline of framed values written at once
+typedef struct {
+    int fd;
+    bool connected;
+    char request[LOAD_MAX_BYTES];
+    size_t request_length;
+    size_t request_sent;  // Bytes of the request written so far
+    char expected[LOAD_MAX_BYTES];
+    size_t expected_length;
+    size_t reply_length;  // Bytes of each reply in the expected ones
+    size_t replies_checked;
+    size_t received;
+    char response[LOAD_MAX_BYTES];
+    uint64_t sent_at;
+} LoadConnection;
+
+// State of a load run: the connections, their shared epoll set and the
+// latency of every completed request
+typedef struct {
+    int epoll_fd;
+    LoadConnection* connections;
+    int count;
+    int depth;  // Framed requests per exchange, 0 for one bare value
+    int open;
+    uint64_t deadline;
+    uint64_t* latencies;
+    size_t completed;
+    size_t capacity;
+    size_t connect_failures;
+    size_t errors;
+    uint64_t random_state;
+} LoadGenerator;
+
+// Function to read a monotonic clock in nanoseconds
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Function to advance a xorshift64 generator
+uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Function to order latency samples
+int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Function to raise the descriptor limit to the hard limit, since every
+// connection holds one
+void raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Function to close a load connection
+void load_close(LoadGenerator* gen, LoadConnection* conn) {
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+        gen->open--;
+    }
+}
+
+// Function to write the rest of the request in flight. Returns false when
+// the connection failed.
+bool load_write_request(LoadConnection* conn) {
+    while (conn->request_sent < conn->request_length) {
+        ssize_t sent = send(conn->fd, conn->request + conn->request_sent,
+                            conn->request_length - conn->request_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        conn->request_sent += sent;
+    }
+    return true;
+}
+
+// Function to start the next exchange on a connection, or close it once
+// the run is over
+void load_start_request(LoadGenerator* gen, LoadConnection* conn) {
+    if (now_ns() >= gen->deadline) {
+        load_close(gen, conn);
+        return;
+    }
+    
+    if (gen->depth == 0) {
+        uint32_t value = (uint32_t)next_random(&gen->random_state);
+        uint32_t message = htonl(value);
+        memcpy(conn->request, &message, sizeof(message));
+        conn->request_length = sizeof(message);
+        conn->expected_length = snprintf(conn->expected, RESPONSE_MAX, "Processed value: %u",
+                                         value);
+        conn->reply_length = conn->expected_length;
+    } else {
+        // The whole pipeline goes out in one write; each reply echoes its
+        // request
+        uint32_t frame[2];
+        frame[0] = htonl(sizeof(uint32_t));
+        for (int i = 0; i < gen->depth; i++) {
+            frame[1] = htonl((uint32_t)next_random(&gen->random_state));
+            memcpy(conn->request + i * FRAME_SIZE, frame, FRAME_SIZE);
+        }
+        conn->request_length = gen->depth * FRAME_SIZE;
+        memcpy(conn->expected, conn->request, conn->request_length);
+        conn->expected_length = conn->request_length;
+        conn->reply_length = FRAME_SIZE;
+    }
+    conn->replies_checked = 0;
+    conn->request_sent = 0;
+    conn->received = 0;
+    conn->sent_at = now_ns();
+    if (!load_write_request(conn)) {
+        gen->errors++;
+        load_close(gen, conn);
+    }
+}
+
+// Function to record the latency of a completed request
+void load_record(LoadGenerator* gen, uint64_t latency) {
+    if (gen->completed == gen->capacity) {
+        size_t capacity = gen->capacity ? gen->capacity * 2 : 1 << 16;
+        uint64_t* latencies = (uint64_t*)realloc(gen->latencies, capacity * sizeof(uint64_t));
+        if (!latencies) {
+            printf("Failed to grow latency samples\n");
+            exit(1);
+        }
+        gen->latencies = latencies;
+        gen->capacity = capacity;
+    }
+    gen->latencies[gen->completed++] = latency;
+}
+
+// Function to handle readiness on a load connection. Bare replies carry
+// no length, so the expected replies are prepared up front and each is
+// checked and timed once it has arrived in full, however the stream was
+// split.
+void load_handle_event(LoadGenerator* gen, LoadConnection* conn, uint32_t events) {
+    if (!conn->connected) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+            gen->connect_failures++;
+            load_close(gen, conn);
+            return;
+        }
+        if (!(events & EPOLLOUT)) {
+            return;
+        }
+        conn->connected = true;
+        load_start_request(gen, conn);
+        return;
+    }
+    
+    if (events & EPOLLOUT) {
+        if (!load_write_request(conn)) {
+            gen->errors++;
+            load_close(gen, conn);
+            return;
+        }
+    }
+    
+    while (conn->fd >= 0) {
+        ssize_t bytes = recv(conn->fd, conn->response + conn->received,
+                             LOAD_MAX_BYTES - conn->received, 0);
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (bytes <= 0) {
+            gen->errors++;
+            load_close(gen, conn);
+            return;
+        }
+        conn->received += bytes;
+        if (conn->received > conn->expected_length) {
+            gen->errors++;
+            load_close(gen, conn);
+            return;
+        }
+        
+        uint64_t now = now_ns();
+        while ((conn->replies_checked + 1) * conn->reply_length <= conn->received) {
+            size_t offset = conn->replies_checked * conn->reply_length;
+            if (memcmp(conn->response + offset, conn->expected + offset, conn->reply_length) != 0) {
+                gen->errors++;
+                load_close(gen, conn);
+                return;
+            }
+            load_record(gen, now - conn->sent_at);
+            conn->replies_checked++;
+        }
+        if (conn->received == conn->expected_length) {
+            load_start_request(gen, conn);
+        }
+    }
+}
+
+// Function to open the load connections without waiting for each one
+int load_connect_all(LoadGenerator* gen, struct sockaddr_in* serv_addr) {
+    for (int i = 0; i < gen->count; i++) {
+        LoadConnection* conn = &gen->connections[i];
+        conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (conn->fd < 0) {
+            perror("Socket creation error");
+            return -1;
+        }
+        gen->open++;
+        
+        int opt = 1;
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        if (connect(conn->fd, (struct sockaddr*)serv_addr, sizeof(*serv_addr)) < 0 &&
+            errno != EINPROGRESS) {
+            gen->connect_failures++;
+            load_close(gen, conn);
+            continue;
+        }
+        
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = conn;
+        if (epoll_ctl(gen->epoll_fd, EPOLL_CTL_ADD, conn->fd, &event) < 0) {
+            perror("epoll_ctl failed");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to run a closed-loop load test: every connection sends a
+// request (or depth framed ones), waits for the replies and sends again
+// until time runs out. Prints requests/sec and the latency distribution.
+int run_load(int connections, int depth, int seconds) {
+    raise_fd_limit();
+    
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(PORT);
+    inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
+    
+    LoadGenerator gen;
+    memset(&gen, 0, sizeof(gen));
+    gen.count = connections;
+    gen.depth = depth;
+    gen.random_state = 0x2545F4914F6CDD1DULL;
+    gen.connections = (LoadConnection*)calloc(connections, sizeof(LoadConnection));
+    gen.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (!gen.connections || gen.epoll_fd < 0) {
+        printf("Failed to set up load generator\n");
+        return 1;
+    }
+    
+    uint64_t start = now_ns();
+    gen.deadline = start + (uint64_t)seconds * 1000000000ULL;
+    if (load_connect_all(&gen, &serv_addr) < 0) {
+        return 1;
+    }
+    
+    struct epoll_event events[LOAD_MAX_EVENTS];
+    while (gen.open > 0) {
+        int ready = epoll_wait(gen.epoll_fd, events, LOAD_MAX_EVENTS, 100);
+        if (ready < 0 && errno != EINTR) {
+            perror("epoll_wait failed");
+            return 1;
+        }
+        for (int i = 0; i < ready; i++) {
+            LoadConnection* conn = (LoadConnection*)events[i].data.ptr;
+            if (conn->fd >= 0) {
+                load_handle_event(&gen, conn, events[i].events);
+            }
+        }
+        
+        // Drop connections whose reply never came
+        if (now_ns() >= gen.deadline + 1000000000ULL) {
+            for (int i = 0; i < gen.count; i++) {
+                if (gen.connections[i].fd >= 0) {
+                    gen.errors++;
+                    load_close(&gen, &gen.connections[i]);
+                }
+            }
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+    
+    printf("Connections: %d (%zu failed to connect)\n", connections, gen.connect_failures);
+    if (depth > 0) {
+        printf("Pipeline depth: %d framed requests\n", depth);
+    }
+    printf("Requests: %zu in %.2f s, %zu errors\n", gen.completed, elapsed / 1e9, gen.errors);
+    printf("Throughput: %.0f requests/sec\n", gen.completed * 1e9 / elapsed);
+    if (gen.completed > 0) {
+        qsort(gen.latencies, gen.completed, sizeof(uint64_t), compare_u64);
+        printf("Latency us: p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+               gen.latencies[gen.completed / 2] / 1e3,
+               gen.latencies[gen.completed * 90 / 100] / 1e3,
+               gen.latencies[gen.completed * 99 / 100] / 1e3,
+               gen.latencies[gen.completed * 999 / 1000] / 1e3,
+               gen.latencies[gen.completed - 1] / 1e3);
+    }
+    
+    close(gen.epoll_fd);
+    free(gen.connections);
+    free(gen.latencies);
+    return 0;
+}
+
+// Function to run a load test with one bare value per exchange
+int run_load_test(int argc, char** argv) {
+    int connections = argc > 0 ? atoi(argv[0]) : LOAD_DEFAULT_CONNECTIONS;
+    int seconds = argc > 1 ? atoi(argv[1]) : LOAD_DEFAULT_SECONDS;
+    if (connections < 1 || seconds < 1) {
+        printf("Usage: load [connections] [seconds]\n");
+        return 1;
+    }
+    return run_load(connections, 0, seconds);
+}
+
+// Function to run a load test with pipelines of framed values, against a
+// server started with the framed protocol
+int run_pipeline_test(int argc, char** argv) {
+    int connections = argc > 0 ? atoi(argv[0]) : LOAD_DEFAULT_CONNECTIONS;
+    int depth = argc > 1 ? atoi(argv[1]) : PIPELINE_DEFAULT_DEPTH;
+    int seconds = argc > 2 ? atoi(argv[2]) : LOAD_DEFAULT_SECONDS;
+    if (connections < 1 || depth < 1 || depth > PIPELINE_MAX_DEPTH || seconds < 1) {
+        printf("Usage: pipeline [connections] [depth 1-%d] [seconds]\n", PIPELINE_MAX_DEPTH);
+        return 1;
+    }
+    return run_load(connections, depth, seconds);
+}
+
+int main(int argc, char** argv) {
+    // "load [connections] [seconds]" drives the server with many
+    // concurrent connections instead of sending one request
+    if (argc > 1 && strcmp(argv[1], "load") == 0) {
+        return run_load_test(argc - 2, argv + 2);
+    }
+    
+    // "pipeline [connections] [depth] [seconds]" does the same with depth
+    // framed requests in flight per connection
+    if (argc > 1 && strcmp(argv[1], "pipeline") == 0) {
+        return run_pipeline_test(argc - 2, argv + 2);
+    }
+    
     int sock = 0;
     struct sockaddr_in serv_addr;
     char buffer[BUFFER_SIZE] = {0};
@@ -35,15 +411,18 @@ int main() {
         return -1;
     }
     
-    // Send test message
-    const char* message = "Hello from client";
-    send(sock, message, strlen(message), 0);
-    printf("Message sent: %s\n", message);
+    // Send test value in network byte order, as the server expects
+    uint32_t value = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 42;
+    uint32_t message = htonl(value);
+    send(sock, &message, sizeof(message), 0);
+    printf("Value sent: %u\n", value);
     
     // Receive response
-    int valread = read(sock, buffer, BUFFER_SIZE);
-    printf("Response from server: %s\n", buffer);
+    int valread = read(sock, buffer, BUFFER_SIZE - 1);
+    if (valread > 0) {
+        printf("Response from server: %s\n", buffer);
+    }
     
     close(sock);
     return 0;
-} 
\ No newline at end of file
+}